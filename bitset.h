@@ -0,0 +1,82 @@
+#ifndef BITSET_H
+#define BITSET_H
+
+/* Packed bit sets over the sequence numbers 0..n-1, used for windows that
+   wrap around at n.  Runs of set bits are found a 64-bit word at a time
+   with count-trailing-zeros, so sliding a window base past k packets costs
+   about k/64 word operations rather than k.  Bits n and above in the last
+   word are always clear. */
+
+#include <stdint.h>
+#include <string.h>
+
+#define BITSET_WORDS(n) (((n) + 63) / 64)
+
+static inline void bitset_clearall(uint64_t *b, int n)
+{
+  memset(b, 0, BITSET_WORDS(n) * sizeof(uint64_t));
+}
+
+static inline int bitset_test(const uint64_t *b, int i)
+{
+  return (b[i >> 6] >> (i & 63)) & 1;
+}
+
+static inline void bitset_set(uint64_t *b, int i)
+{
+  b[i >> 6] |= (uint64_t)1 << (i & 63);
+}
+
+static inline void bitset_clear(uint64_t *b, int i)
+{
+  b[i >> 6] &= ~((uint64_t)1 << (i & 63));
+}
+
+/* the 64 bits from i on, wrapping from n-1 to 0, with bit i lowest */
+static inline uint64_t bitset_get64(const uint64_t *b, int n, int i)
+{
+  uint64_t w = 0, part;
+  int got, len;
+
+  for (got = 0; got < 64; got += len) {
+    len = 64 - (i & 63);        /* to the end of i's word ... */
+    if (len > n - i)
+      len = n - i;              /* ... or of the set */
+    if (len > 64 - got)
+      len = 64 - got;
+    part = b[i >> 6] >> (i & 63);
+    if (len < 64)
+      part &= ((uint64_t)1 << len) - 1;
+    w |= part << got;
+    i += len;
+    if (i >= n)
+      i = 0;
+  }
+  return w;
+}
+
+/* clear the run of set bits starting at i, wrapping from n-1 to 0, and
+   return its length; 0 if bit i is clear */
+static inline int bitset_take_run(uint64_t *b, int n, int i)
+{
+  uint64_t w, ones;
+  int bit, len, total = 0;
+
+  for (;;) {
+    bit = i & 63;
+    w = ~b[i >> 6] >> bit;      /* clear bits of the word, from bit i up */
+    len = w ? __builtin_ctzll(w) : 64 - bit;
+    if (len == 0)
+      return total;
+    ones = len == 64 ? ~(uint64_t)0 : (((uint64_t)1 << len) - 1);
+    b[i >> 6] &= ~(ones << bit);
+    total += len;
+    i += len;
+    if (i >= n)
+      i = 0;
+    else if (len < 64 - bit)
+      return total;             /* the run ended inside this word */
+  }
+}
+
+#endif
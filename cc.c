@@ -0,0 +1,122 @@
+#include <string.h>
+#include "cc.h"
+#include "sim.h"
+
+static void none_init(struct cc *cc)
+{
+  cc->cwnd = cc->window;
+  cc->ssthresh = cc->window;
+}
+
+static void none_ack(struct cc *cc, int nacked)
+{
+}
+
+static void none_loss(struct cc *cc, int inflight)
+{
+}
+
+static const struct cc_algorithm cc_none = {
+  "none", none_init, none_ack, none_loss, none_loss
+};
+
+static void reno_init(struct cc *cc)
+{
+  cc->cwnd = 1.0;
+  cc->ssthresh = cc->window;
+}
+
+static void reno_ack(struct cc *cc, int nacked)
+{
+  for (; nacked > 0; nacked--) {
+    if (cc->cwnd < cc->ssthresh)
+      cc->cwnd += 1.0;                  /* slow start */
+    else
+      cc->cwnd += 1.0 / cc->cwnd;       /* congestion avoidance */
+  }
+  if (cc->cwnd > cc->window)
+    cc->cwnd = cc->window;
+}
+
+static void reno_loss(struct cc *cc, int inflight)
+{
+  cc->ssthresh = inflight / 2.0 < 2.0 ? 2.0 : inflight / 2.0;
+  cc->cwnd = cc->ssthresh;
+}
+
+static void reno_timeout(struct cc *cc, int inflight)
+{
+  cc->ssthresh = inflight / 2.0 < 2.0 ? 2.0 : inflight / 2.0;
+  cc->cwnd = 1.0;
+}
+
+static const struct cc_algorithm cc_reno = {
+  "reno", reno_init, reno_ack, reno_loss, reno_timeout
+};
+
+const struct cc_algorithm *const cc_algorithms[] = {
+  &cc_none,
+  &cc_reno,
+  NULL
+};
+
+const struct cc_algorithm *cc_find(const char *name)
+{
+  int i;
+
+  if (name[0] == '\0')
+    return cc_algorithms[0];
+  for (i = 0; cc_algorithms[i] != NULL; i++)
+    if (strcmp(cc_algorithms[i]->name, name) == 0)
+      return cc_algorithms[i];
+  return NULL;
+}
+
+/* keep the run's window statistics and log the window if it or the
+   threshold changed */
+static void changed(struct sim *sim, const struct cc *cc, double before,
+                    double ssthresh_before, const char *why)
+{
+  struct sim_stats *st = &sim->stats;
+
+  st->cwnd_area += st->cwnd_last * (sim->time - st->cwnd_since);
+  st->cwnd_since = sim->time;
+  st->cwnd_last = cc->cwnd;
+  if (sim->cwndlog != NULL && (cc->cwnd != before || cc->ssthresh != ssthresh_before))
+    fprintf(sim->cwndlog, "%f,%f,%f,%s\n", sim->time, cc->cwnd, cc->ssthresh, why);
+}
+
+void cc_init(struct sim *sim, struct cc *cc, int window)
+{
+  cc->alg = cc_find(sim->params.cc);
+  cc->window = window;
+  cc->alg->init(cc);
+  sim->stats.cwnd_since = sim->time;
+  changed(sim, cc, -1.0, -1.0, "init");
+}
+
+void cc_ack(struct sim *sim, struct cc *cc, int nacked)
+{
+  double before = cc->cwnd, ssthresh_before = cc->ssthresh;
+
+  cc->alg->ack(cc, nacked);
+  changed(sim, cc, before, ssthresh_before, "ack");
+}
+
+void cc_loss(struct sim *sim, struct cc *cc, int inflight)
+{
+  double before = cc->cwnd, ssthresh_before = cc->ssthresh;
+
+  cc->alg->loss(cc, inflight);
+  sim->stats.cc_losses++;
+  changed(sim, cc, before, ssthresh_before, "loss");
+}
+
+void cc_timeout(struct sim *sim, struct cc *cc, int inflight)
+{
+  double before = cc->cwnd, ssthresh_before = cc->ssthresh;
+
+  cc->alg->timeout(cc, inflight);
+  sim->stats.cc_timeouts++;
+  changed(sim, cc, before, ssthresh_before, "timeout");
+}
@@ -0,0 +1,64 @@
+#ifndef CC_H
+#define CC_H
+
+/* Sender congestion control.
+
+   A congestion control algorithm keeps a congestion window, cwnd, of
+   packets the sender may have unacknowledged, which the sender applies
+   on top of its own window.  It is told about ACKs and about losses,
+   found either by the timer going off or by duplicate ACKs.
+
+   "none" leaves the window alone.  "reno" is TCP Reno's (RFC 5681): slow
+   start from one packet, growing cwnd by a packet for each packet ACKed
+   up to ssthresh, then congestion avoidance growing it by about a packet
+   per window.  A loss found by duplicate ACKs halves cwnd, a timeout sets
+   ssthresh to half the packets in flight and cwnd back to one.
+
+   Algorithms are listed in cc.c and picked by name with the cc parameter;
+   each is a struct cc_algorithm. */
+
+struct sim;
+
+struct cc {
+  const struct cc_algorithm *alg;
+  double cwnd;            /* congestion window, in packets */
+  double ssthresh;        /* slow start threshold, in packets */
+  int window;             /* the sender's own window, cwnd's upper bound */
+};
+
+struct cc_algorithm {
+  const char *name;
+  void (*init)(struct cc *);
+  void (*ack)(struct cc *, int nacked);           /* nacked new packets ACKed */
+  void (*loss)(struct cc *, int inflight);        /* found by duplicate ACKs */
+  void (*timeout)(struct cc *, int inflight);
+};
+
+/* every algorithm, ending with NULL; the first is the default */
+extern const struct cc_algorithm *const cc_algorithms[];
+
+/* the algorithm called name, the default if name is "", or NULL */
+extern const struct cc_algorithm *cc_find(const char *name);
+
+/* set up the congestion control the simulation asks for over a sender
+   window of window packets */
+extern void cc_init(struct sim *sim, struct cc *cc, int window);
+
+/* nacked packets were newly ACKed */
+extern void cc_ack(struct sim *sim, struct cc *cc, int nacked);
+
+/* a loss was found by duplicate ACKs with inflight packets unACKed */
+extern void cc_loss(struct sim *sim, struct cc *cc, int inflight);
+
+/* the timer went off with inflight packets unACKed */
+extern void cc_timeout(struct sim *sim, struct cc *cc, int inflight);
+
+/* how many packets the sender may now have unACKed */
+static inline int cc_window(const struct cc *cc)
+{
+  if (cc->cwnd < cc->window)
+    return cc->cwnd < 1.0 ? 1 : (int)cc->cwnd;
+  return cc->window;
+}
+
+#endif
@@ -0,0 +1,248 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "channel.h"
+
+/* RED's weight for the moving average and its drop probability at the
+   upper threshold; the thresholds are a quarter and three quarters of
+   the queue limit */
+#define RED_WEIGHT 0.002
+#define RED_MAXP   0.1
+
+/* read the 0s and 1s of a loss trace, ignoring anything else */
+static int load_losses(struct channel *ch, const char *path)
+{
+  FILE *f;
+  int c, cap = 0;
+  uint8_t *grown;
+
+  if ((f = fopen(path, "r")) == NULL) {
+    fprintf(stderr, "cannot open loss trace %s\n", path);
+    return -1;
+  }
+  while ((c = getc(f)) != EOF) {
+    if (c != '0' && c != '1')
+      continue;
+    if (ch->nlosses == cap) {
+      cap = cap ? 2 * cap : 1024;
+      grown = realloc(ch->losses, cap);
+      if (grown == NULL) {
+        printf("memory allocation for loss trace failed.");
+        exit(EXIT_FAILURE);
+      }
+      ch->losses = grown;
+    }
+    ch->losses[ch->nlosses++] = c == '1';
+  }
+  fclose(f);
+  if (ch->nlosses == 0) {
+    fprintf(stderr, "loss trace %s has no 0s or 1s\n", path);
+    return -1;
+  }
+  return 0;
+}
+
+/* read the "delay weight" lines of an empirical delay distribution, kept
+   sorted by delay with the weights summed into a distribution function */
+static int load_delays(struct channel *ch, const char *path)
+{
+  char line[256], *s;
+  FILE *f;
+  float delay, weight;
+  double total = 0.0;
+  int i, cap = 0, lineno = 0;
+
+  if ((f = fopen(path, "r")) == NULL) {
+    fprintf(stderr, "cannot open delay file %s\n", path);
+    return -1;
+  }
+  while (fgets(line, sizeof(line), f) != NULL) {
+    lineno++;
+    if ((s = strchr(line, '#')) != NULL)
+      *s = '\0';
+    if (strspn(line, " \t\r\n") == strlen(line))
+      continue;
+    if (sscanf(line, "%f %f", &delay, &weight) != 2 || delay < 0.0 || weight <= 0.0) {
+      fprintf(stderr, "%s:%d: expected a delay and a positive weight\n", path, lineno);
+      fclose(f);
+      return -1;
+    }
+    if (ch->ndelays == cap) {
+      cap = cap ? 2 * cap : 64;
+      ch->delays = realloc(ch->delays, cap * sizeof(float));
+      ch->cdf = realloc(ch->cdf, cap * sizeof(double));
+      if (ch->delays == NULL || ch->cdf == NULL) {
+        printf("memory allocation for delay distribution failed.");
+        exit(EXIT_FAILURE);
+      }
+    }
+    for (i = ch->ndelays++; i > 0 && ch->delays[i-1] > delay; i--) {
+      ch->delays[i] = ch->delays[i-1];
+      ch->cdf[i] = ch->cdf[i-1];
+    }
+    ch->delays[i] = delay;
+    ch->cdf[i] = weight;
+    total += weight;
+  }
+  fclose(f);
+  if (ch->ndelays == 0) {
+    fprintf(stderr, "delay file %s has no delays\n", path);
+    return -1;
+  }
+  for (i = 1; i < ch->ndelays; i++)
+    ch->cdf[i] += ch->cdf[i-1];
+  for (i = 0; i < ch->ndelays; i++)
+    ch->cdf[i] /= total;
+  return 0;
+}
+
+int channel_init(struct channel *ch, const struct link_params *link)
+{
+  memset(ch, 0, sizeof(*ch));
+  ch->link = *link;
+  if (link->lossmodel == LOSS_TRACE && load_losses(ch, link->losstrace) < 0)
+    return -1;
+  if (link->delaydist == DELAY_EMPIRICAL && load_delays(ch, link->delayfile) < 0)
+    return -1;
+  if (link->reorder > 0.0) {
+    ch->recent = calloc(link->reorderdepth + 1, sizeof(float));
+    if (ch->recent == NULL) {
+      printf("memory allocation for channel failed.");
+      exit(EXIT_FAILURE);
+    }
+  }
+  return 0;
+}
+
+void channel_free(struct channel *ch)
+{
+  free(ch->losses);
+  free(ch->delays);
+  free(ch->cdf);
+  free(ch->recent);
+}
+
+float channel_tail(const struct channel *ch, float now)
+{
+  if (ch->tail > now)
+    return ch->tail;
+  return now;
+}
+
+float channel_reorder_tail(const struct channel *ch, float now)
+{
+  if (ch->recent[ch->recentpos] > now)
+    return ch->recent[ch->recentpos];
+  return now;
+}
+
+void channel_scheduled(struct channel *ch, float arrival)
+{
+  if (arrival < ch->tail) {
+    ch->reordered++;
+    return;
+  }
+  ch->tail = arrival;
+  if (ch->recent != NULL) {
+    ch->recent[ch->recentpos] = arrival;
+    ch->recentpos = (ch->recentpos + 1) % (ch->link.reorderdepth + 1);
+  }
+}
+
+/* RED: true if a packet arriving to find backlog packets queued is
+   dropped early */
+static int red_drop(struct channel *ch, double now, double backlog, double u)
+{
+  double minth = 0.25 * ch->link.queue, maxth = 0.75 * ch->link.queue;
+  double p;
+
+  /* the average decays while the link is idle, as if packets that found
+     the queue empty had arrived at the link's rate */
+  if (backlog == 0.0 && ch->busy < now)
+    ch->avg *= pow(1.0 - RED_WEIGHT, (now - ch->busy) * ch->link.bandwidth);
+  ch->avg += RED_WEIGHT * (backlog - ch->avg);
+
+  if (ch->avg < minth)
+    return 0;
+  if (ch->avg >= maxth)
+    p = 1.0;
+  else
+    p = RED_MAXP * (ch->avg - minth) / (maxth - minth);
+  return u < p;
+}
+
+float channel_transmit(struct channel *ch, float now, double u)
+{
+  double start, backlog, sendtime = 1.0 / ch->link.bandwidth;
+
+  /* packets still queued, the one being sent counting as a whole one */
+  start = ch->busy > now ? ch->busy : now;
+  backlog = ceil((start - now) / sendtime - 1e-6);
+
+  if (ch->link.aqm == LINK_RED && red_drop(ch, now, backlog, u)) {
+    ch->early_drops++;
+    return -1.0;
+  }
+  if (ch->link.queue > 0 && backlog >= ch->link.queue) {
+    ch->drops++;
+    return -1.0;
+  }
+
+  ch->sent++;
+  ch->wait += start - now;
+  if (start - now > ch->wait_max)
+    ch->wait_max = start - now;
+  ch->busy = start + sendtime;
+  ch->busytime += sendtime;
+  return (float)(ch->busy + ch->link.delay);
+}
+
+int channel_lost(struct channel *ch, struct rng *rng)
+{
+  int lost;
+
+  switch (ch->link.lossmodel) {
+  case LOSS_GE:
+    /* move between the states, then lose the packet with the
+       probability of the state it is in */
+    if (rng_uniform(rng) < (ch->bad ? ch->link.ge_r : ch->link.ge_p))
+      ch->bad = !ch->bad;
+    return rng_uniform(rng) < (ch->bad ? ch->link.ge_bad : ch->link.ge_good);
+  case LOSS_TRACE:
+    lost = ch->losses[ch->losspos];
+    ch->losspos = (ch->losspos + 1) % ch->nlosses;
+    return lost;
+  default:
+    return 0;
+  }
+}
+
+float channel_delay(struct channel *ch, struct rng *rng)
+{
+  double u = rng_uniform(rng);
+  int lo, hi, mid;
+
+  if (u >= 1.0)                 /* keep the logs below finite */
+    u = 1.0 - 1e-12;
+  switch (ch->link.delaydist) {
+  case DELAY_EXP:
+    return ch->link.delaymin - ch->link.delaymean * log(1.0 - u);
+  case DELAY_PARETO:
+    return ch->link.delaymin / pow(1.0 - u, 1.0 / ch->link.delayshape);
+  case DELAY_EMPIRICAL:
+    /* the first delay whose share of the weight reaches u */
+    lo = 0;
+    hi = ch->ndelays - 1;
+    while (lo < hi) {
+      mid = (lo + hi) / 2;
+      if (ch->cdf[mid] < u)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    return ch->delays[lo];
+  default:
+    return ch->link.delaymin + (ch->link.delaymax - ch->link.delaymin) * u;
+  }
+}
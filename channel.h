@@ -0,0 +1,160 @@
+#ifndef CHANNEL_H
+#define CHANNEL_H
+
+/* State of one direction of the emulated medium.  The emulator keeps one
+   channel per receiving entity: channels[B] carries packets from A to B,
+   channels[A] carries packets from B to A.
+
+   By default a packet arrives 1 to 10 time units after the latest one in
+   flight.  With a bandwidth set, the channel is instead a link that
+   sends bandwidth packets per time unit, every packet being the same
+   size, from a queue of at most queue packets, and each one arrives
+   delay time units after it has been sent.  A packet that finds the
+   queue full is dropped (drop-tail), or with LINK_RED is dropped early
+   with a probability rising with the average queue length.
+
+   Packets are lost independently with the run's loss probability
+   (LOSS_BERNOULLI), or in bursts by a Gilbert-Elliott model (LOSS_GE),
+   which moves between a good and a bad state with a loss probability
+   each, or as a trace file says (LOSS_TRACE).  Without a bandwidth, the
+   time a packet takes after the latest one in flight is drawn from a
+   uniform, exponential, Pareto or empirical distribution.
+
+   Without a bandwidth the medium can also reorder: with probability
+   reorder a packet takes its delay after the packet reorderdepth places
+   before the latest one in flight instead, so it can overtake up to
+   reorderdepth packets. */
+
+#include <stdint.h>
+#include "rng.h"
+
+#define LINK_DROPTAIL 0
+#define LINK_RED      1
+
+#define LOSS_BERNOULLI 0
+#define LOSS_GE        1
+#define LOSS_TRACE     2
+
+#define DELAY_UNIFORM   0   /* delaymin to delaymax */
+#define DELAY_EXP       1   /* delaymin plus an exponential of mean delaymean */
+#define DELAY_PARETO    2   /* Pareto of scale delaymin and shape delayshape */
+#define DELAY_EMPIRICAL 3   /* as often as the weights in delayfile say */
+
+/* how one direction of the medium behaves, set by the user */
+struct link_params {
+  float bandwidth;  /* packets sent per time unit, 0 for the default medium */
+  float delay;      /* propagation delay; this and the rest are only
+                       used with a bandwidth */
+  int queue;        /* most packets queued, including the one being sent,
+                       0 for no limit */
+  int aqm;          /* LINK_DROPTAIL or LINK_RED */
+
+  int lossmodel;    /* LOSS_BERNOULLI, LOSS_GE or LOSS_TRACE */
+  float ge_p;       /* chance per packet of going from the good state to the bad */
+  float ge_r;       /* and from the bad state back to the good */
+  float ge_good;    /* loss probability in the good state */
+  float ge_bad;     /* and in the bad state */
+  char losstrace[256];  /* a 1 for each packet lost, a 0 for each one not,
+                           repeated when it runs out */
+
+  int delaydist;    /* DELAY_UNIFORM, DELAY_EXP, DELAY_PARETO or DELAY_EMPIRICAL */
+  float delaymin, delaymax, delaymean, delayshape;
+  char delayfile[256];  /* "delay weight" lines */
+
+  float reorder;    /* chance of a packet being let overtake others */
+  int reorderdepth; /* most packets it overtakes */
+};
+
+struct channel {
+  float tail;      /* arrival time of the latest packet scheduled on this channel */
+
+  struct link_params link;
+  double busy;     /* when the link has sent every packet queued */
+  double avg;      /* RED's moving average of the queue length */
+
+  int bad;         /* the Gilbert-Elliott model is in its bad state */
+  uint8_t *losses; /* the loss trace, one entry per packet */
+  int nlosses, losspos;
+  float *delays;   /* the empirical delays, in increasing order */
+  double *cdf;     /* the share of the weight up to each delay */
+  int ndelays;
+  float *recent;   /* arrival times of the last reorderdepth + 1 packets
+                      sent in order, oldest at recentpos; NULL if the
+                      channel does not reorder */
+  int recentpos;
+
+  /* what happened on the link */
+  int sent;        /* packets queued and sent */
+  int drops;       /* packets dropped on a full queue */
+  int early_drops; /* packets dropped early by RED */
+  double wait;     /* total time sent packets spent queued */
+  float wait_max;
+  double busytime; /* total time spent sending */
+
+  /* what the loss and delay models did */
+  int lost;        /* packets lost */
+  int bursts;      /* runs of packets lost one after another */
+  int burst, burst_max;  /* length of the current run and the longest */
+  int ndelayed;    /* packets given a delay */
+  double delaysum;
+  int reordered;   /* packets scheduled to arrive before one sent earlier */
+};
+
+/* set up the channel for link; returns -1 after printing why if a loss
+   trace or delay file cannot be read */
+extern int channel_init(struct channel *ch, const struct link_params *link);
+extern void channel_free(struct channel *ch);
+
+/* the time after which a packet sent at time now must arrive so that it
+   does not overtake a packet already in flight (the medium cannot reorder) */
+extern float channel_tail(const struct channel *ch, float now);
+
+/* like channel_tail(), for a packet that may overtake reorderdepth
+   packets in flight */
+extern float channel_reorder_tail(const struct channel *ch, float now);
+
+/* record that a packet has been scheduled to arrive at time arrival */
+extern void channel_scheduled(struct channel *ch, float arrival);
+
+/* true if the channel is a link with a bandwidth */
+static inline int channel_is_link(const struct channel *ch)
+{
+  return ch->link.bandwidth > 0.0;
+}
+
+/* queue a packet on the link at time now; returns its arrival time, or
+   -1 if the queue drops it.  u is a uniform random number in [0,1) that
+   RED uses to decide an early drop. */
+extern float channel_transmit(struct channel *ch, float now, double u);
+
+/* whether the next packet is lost, by the channel's model if it is not
+   LOSS_BERNOULLI; the emulator draws those itself */
+extern int channel_lost(struct channel *ch, struct rng *rng);
+
+/* the time the next packet takes after the latest in flight, from the
+   channel's distribution if it is not DELAY_UNIFORM */
+extern float channel_delay(struct channel *ch, struct rng *rng);
+
+/* count whether a packet was lost, for the burst statistics */
+static inline void channel_count_loss(struct channel *ch, int lost)
+{
+  if (!lost) {
+    ch->burst = 0;
+    return;
+  }
+  ch->lost++;
+  if (ch->burst++ == 0)
+    ch->bursts++;
+  if (ch->burst > ch->burst_max)
+    ch->burst_max = ch->burst;
+}
+
+/* true if the channel's loss or delay is not drawn as in the original
+   medium, or it reorders */
+static inline int channel_is_modelled(const struct channel *ch)
+{
+  return ch->link.lossmodel != LOSS_BERNOULLI || ch->link.delaydist != DELAY_UNIFORM
+    || ch->link.reorder > 0.0;
+}
+
+#endif
@@ -36,360 +36,513 @@
    ********************************************************************* */
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <getopt.h>
 #include "emulator.h"
-#include "gbn.h"
-
-struct event {
-  float evtime;           /* event time */
-  int evtype;             /* event type code */
-  int eventity;           /* entity where event occurs */
-  struct pkt *pktptr;     /* ptr to packet (if any) assoc w/ this event */
-  struct event *prev;
-  struct event *next;
-};
-
-struct event *evlist = NULL;   /* the event list */
-
-/* possible events: */
-#define  TIMER_INTERRUPT 0  
-#define  FROM_LAYER5     1
-#define  FROM_LAYER3     2
+#include "sim.h"
+#include "sweep.h"
 
 #define  OFF             0
 #define  ON              1
 
-int TRACE = 3;
-
-/* statistics updated by GBN */
-int window_full;   /* count of the number of messages dropped due to full window */
-int total_ACKs_received;
-int packets_resent;       /* count of the number of packets resent  */
-int new_ACKs;           /* count of the number of acks correctly received */
-int packets_received;  /* count of the packets received by receiver */
-
-/* statistics updated by emulator */
-static int packets_lost;  
-static int packets_corrupt;
-static int packets_sent;
-static int packets_timeout;
-static int messages_delivered;
-
-static int nsim = 0;              /* number of messages from 5 to 4 so far */ 
-static int nsimmax = 0;           /* number of msgs to generate, then stop */
-static float time = 0.000;
-static float lossprob;            /* probability that a packet is dropped  */
-static float corruptprob;   /* probability that one bit is packet is flipped */
-static int corruptdirection; /* A->B A<-B or bidirectional corruption/loss */
-static float lambda;        /* arrival rate of messages from layer 5 */   
-static int   ntolayer3;           /* number sent into layer 3 */
-static int   nlost;               /* number lost in media */
-static int ncorrupt;              /* number corrupted by media*/
-
-/****************************************************************************/
-/* jimsrand(): return a double in range [0,1].  The routine below is used to */
-/* isolate all random number generation in one location.  We assume that the*/
-/* system-supplied rand() function return an int in therange [0,mmm]        */
-/****************************************************************************/
-double jimsrand(void) 
+/* append one record to the binary event record, if one is being written */
+static void record_call(struct sim *sim, int kind, int entity, int fate, float value,
+                        const struct pkt *packet)
 {
-  double mmm = RAND_MAX;     /* largest int  - MACHINE DEPENDENT!!!!!!!!   */
-  double x;                   
-  x = rand()/mmm;            /* x should be uniform in [0,1] */
-  if (TRACE > 3)
-    printf("RANDOM NUMBER GENERAION CALLED: %f\n", x);
-  return(x);
-}  
+  struct record rec;
+
+  if (sim->rec == NULL)
+    return;
+  memset(&rec, 0, sizeof(rec));
+  rec.time = sim->time;
+  rec.value = value;
+  rec.kind = kind;
+  rec.entity = entity;
+  rec.fate = fate;
+  if (packet != NULL) {
+    rec.seqnum = packet->seqnum;
+    rec.acknum = packet->acknum;
+    rec.checksum = packet->checksum;
+    memcpy(rec.payload, packet->payload, sizeof(rec.payload));
+  }
+  record_put(sim->rec, &rec);
+}
 
 /********************* EVENT HANDLINE ROUTINES *******/
 /*  The next set of routines handle the event list   */
 /*****************************************************/
 
-void insertevent(struct event *p)
+void insertevent(struct sim *sim, struct event *p)
 {
-  struct event *q,*qold;
-
-  if (TRACE>2) {
-    printf("            INSERTEVENT: time is %f\n",time);
-    printf("            INSERTEVENT: future time will be %f\n",p->evtime); 
-  }
-  q = evlist;     /* q points to front of list in which p struct inserted */
-  if (q==NULL) {   /* list is empty */
-    evlist=p;
-    p->next=NULL;
-    p->prev=NULL;
-  }
-  else {
-    for (qold = q; q !=NULL && p->evtime > q->evtime; q=q->next)
-      qold=q; 
-    if (q==NULL) {   /* end of list */
-      qold->next = p;
-      p->prev = qold;
-      p->next = NULL;
-    }
-    else if (q==evlist) { /* front of list */
-      p->next=evlist;
-      p->prev=NULL;
-      p->next->prev=p;
-      evlist = p;
-    }
-    else {     /* middle of list */
-      p->next=q;
-      p->prev=q->prev;
-      q->prev->next=p;
-      q->prev=p;
-    }
+  if (TRACE_LEVEL(sim) > 2) {
+    trace_printf(sim, "            INSERTEVENT: time is %f\n",sim->time);
+    trace_printf(sim, "            INSERTEVENT: future time will be %f\n",p->evtime); 
   }
+  eventq_push(&sim->evlist, p);
 }
 
-void generate_next_arrival(void)
+void generate_next_arrival(struct sim *sim)
 {
   double x;
   struct event *evptr;
 
-  if (TRACE>2)
-    printf("          GENERATE NEXT ARRIVAL: creating new arrival\n");
+  if (TRACE_LEVEL(sim) > 2)
+    trace_printf(sim, "          GENERATE NEXT ARRIVAL: creating new arrival\n");
  
-  x = lambda*jimsrand()*2;  /* x is uniform on [0,2*lambda] */
+  x = sim->params.lambda*jimsrand(sim)*2;  /* x is uniform on [0,2*lambda] */
   /* having mean of lambda        */
-  evptr = malloc(sizeof(struct event));
-  if (evptr == 0) {
-    printf("memory allocation for event failed.");
-    exit(EXIT_FAILURE);
-  }
-  evptr->evtime =  time + x;
+  evptr = eventq_alloc(&sim->evlist);
+  evptr->evtime =  sim->time + x;
   evptr->evtype =  FROM_LAYER5;
-  if (BIDIRECTIONAL && (jimsrand()>0.5) )
+  if (sim->proto->bidirectional && (jimsrand(sim)>0.5) )
     evptr->eventity = B;
   else
     evptr->eventity = A;
-  insertevent(evptr);
+  insertevent(sim, evptr);
 } 
 
-void printevlist(void)
+void printevlist(struct sim *sim)
 {
   struct event *q;
-  printf("--------------\nEvent List Follows:\n");
-  for(q = evlist; q!=NULL; q=q->next) {
-    printf("Event time: %f, type: %d entity: %d\n",q->evtime,q->evtype,q->eventity);
+  int i;
+  trace_printf(sim, "--------------\nEvent List Follows (heap order):\n");
+  for(i = 0; i < sim->evlist.size; i++) {
+    q = sim->evlist.heap[i];
+    if (q->cancelled)
+      continue;
+    trace_printf(sim, "Event time: %f, type: %d entity: %d\n",q->evtime,q->evtype,q->eventity);
+  }
+  trace_printf(sim, "--------------\n");
+}
+
+void sim_params_default(struct sim_params *p)
+{
+  int i;
+
+  p->nsimmax = 1000;
+  p->lossprob = 0.0;
+  p->corruptprob = 0.0;
+  p->corruptdirection = 0;
+  p->lambda = 10.0;
+  p->trace = 3;
+  p->seed = 9999;
+  p->rng = RNG_XOSHIRO;
+  p->protocol[0] = '\0';
+  p->tracefile[0] = '\0';
+  p->recordfile[0] = '\0';
+  p->rto = RTO_FIXED;
+  p->rtolog[0] = '\0';
+  p->window = 6;        /* MUST BE SET TO 6 when submitting assignment */
+  p->seqspace = 0;
+  p->rtt = 16.0;        /* MUST BE SET TO 16.0 when submitting assignment */
+  p->sack = 0;
+  p->dupacks = 0;
+  p->cc[0] = '\0';
+  p->cwndlog[0] = '\0';
+  p->sendq = 0;
+  p->ackevery = 1;
+  p->ackdelay = 4.0;
+  p->samplelog[0] = '\0';
+  p->sampleinterval = 10.0;
+  p->sampleformat = SAMPLE_CSV;
+  for (i = 0; i < 2; i++) {
+    p->links[i].bandwidth = 0.0;
+    p->links[i].delay = 0.0;
+    p->links[i].queue = 0;
+    p->links[i].aqm = LINK_DROPTAIL;
+    p->links[i].lossmodel = LOSS_BERNOULLI;
+    p->links[i].ge_p = 0.01;
+    p->links[i].ge_r = 0.3;
+    p->links[i].ge_good = 0.0;
+    p->links[i].ge_bad = 0.5;
+    p->links[i].losstrace[0] = '\0';
+    p->links[i].delaydist = DELAY_UNIFORM;
+    p->links[i].delaymin = 1.0;
+    p->links[i].delaymax = 10.0;
+    p->links[i].delaymean = 4.5;
+    p->links[i].delayshape = 1.5;
+    p->links[i].delayfile[0] = '\0';
+    p->links[i].reorder = 0.0;
+    p->links[i].reorderdepth = 3;
   }
-  printf("--------------\n");
 }
 
-void init(void)                         /* initialize the simulator */
+struct sim *sim_create(const struct sim_params *p)
 {
-  float sum, avg;
+  struct sim *sim;
   int i;
 
+  sim = calloc(1, sizeof(struct sim));   /* also zeroes the statistics */
+  if (sim == NULL) {
+    printf("memory allocation for simulator failed.");
+    exit(EXIT_FAILURE);
+  }
+  sim->params = *p;
+  /* load the channels' files first, so nothing else needs undoing if one
+     cannot be read */
+  if (channel_init(&sim->channels[A], &p->links[A]) < 0
+      || channel_init(&sim->channels[B], &p->links[B]) < 0) {
+    channel_free(&sim->channels[A]);
+    channel_free(&sim->channels[B]);
+    free(sim);
+    return NULL;
+  }
+  sim->proto = protocol_find(p->protocol);
+  if (sim->params.seqspace == 0)
+    sim->params.seqspace = sim_params_seqspace(p);
+  sim->trace = p->trace;
+  trace_open(&sim->tsink, p->tracefile);
+
+  rng_seed(&sim->rng, p->rng, p->seed);   /* init random number generator */
+  /* the emulator used to test the system rand() here with 1000 draws;
+     keep consuming them so legacy runs stay reproducible */
+  if (p->rng == RNG_LEGACY)
+    for (i=0; i<1000; i++)
+      jimsrand(sim);
+
+  if (p->recordfile[0] != '\0') {
+    sim->rec = malloc(sizeof(struct recorder));
+    if (sim->rec == NULL) {
+      printf("memory allocation for simulator failed.");
+      exit(EXIT_FAILURE);
+    }
+    if (record_create(sim->rec, p->recordfile) < 0) {
+      free(sim->rec);
+      sim->rec = NULL;
+    }
+  }
+
+  if (p->rtolog[0] != '\0') {
+    sim->rtolog = fopen(p->rtolog, "w");
+    if (sim->rtolog == NULL)
+      fprintf(stderr, "cannot open %s, timeouts are not logged\n", p->rtolog);
+    else
+      fprintf(sim->rtolog, "time,rto,srtt,rttvar,event\n");
+  }
+  if (p->cwndlog[0] != '\0') {
+    sim->cwndlog = fopen(p->cwndlog, "w");
+    if (sim->cwndlog == NULL)
+      fprintf(stderr, "cannot open %s, the congestion window is not logged\n", p->cwndlog);
+    else
+      fprintf(sim->cwndlog, "time,cwnd,ssthresh,event\n");
+  }
+
+  sim->gencap = p->window + p->sendq;      /* as many as A can hold */
+  sim->gen = malloc(sim->gencap * sizeof(struct genmsg));
+  if (sim->gen == NULL) {
+    printf("memory allocation for simulator failed.");
+    exit(EXIT_FAILURE);
+  }
+  hist_init(&sim->latency);
+  hist_init(&sim->hol);
+  sampler_init(&sim->sampler, p->samplelog[0] != '\0' ? p->sampleinterval : 0.0);
+
+  sim->time=0.0;                    /* initialize time to 0.0 */
+  eventq_init(&sim->evlist);
+  sim->timers[A] = NULL;
+  sim->timers[B] = NULL;
+  generate_next_arrival(sim);     /* initialize event list */
+
+  sim->proto->A_init(sim);
+  sim->proto->B_init(sim);
+  return sim;
+}
+
+void sim_free(struct sim *sim)
+{
+  trace_close(&sim->tsink);
+  if (sim->rec != NULL) {
+    record_close(sim->rec);
+    free(sim->rec);
+  }
+  if (sim->rtolog != NULL)
+    fclose(sim->rtolog);
+  if (sim->cwndlog != NULL)
+    fclose(sim->cwndlog);
+  eventq_free(&sim->evlist);
+  channel_free(&sim->channels[A]);
+  channel_free(&sim->channels[B]);
+  free(sim->gen);
+  sampler_free(&sim->sampler);
+  free(sim->state[A]);
+  free(sim->state[B]);
+  free(sim);
+}
+
+void init(struct sim_params *p)      /* read the simulation parameters */
+{
+  /* the prompted run is the original emulator, so use its generator */
+  p->rng = RNG_LEGACY;
+
   printf("-----  Stop and Wait Network Simulator Version 1.1 -------- \n\n");
   printf("Enter the number of messages to simulate: ");
-  scanf("%d",&nsimmax);
+  scanf("%d",&p->nsimmax);
   printf("Enter  packet loss probability [enter 0.0 for no loss]:");
-  scanf("%f",&lossprob);
+  scanf("%f",&p->lossprob);
   printf("Enter packet corruption probability [0.0 for no corruption]:");
-  scanf("%f",&corruptprob);
-  if (lossprob != 0.0 || corruptprob != 0.0) {
+  scanf("%f",&p->corruptprob);
+  if (p->lossprob != 0.0 || p->corruptprob != 0.0) {
     printf("If you want loss or corruption to only occur in one direction, choose the direction: 0 A->B, 1 A<-B, 2 A<->B (both directions) :");
-    scanf("%d",&corruptdirection);
+    scanf("%d",&p->corruptdirection);
   }
   printf("Enter average time between messages from sender's layer5 [ > 0.0]:");
-  scanf("%f",&lambda);
+  scanf("%f",&p->lambda);
   printf("Enter TRACE:");
-  scanf("%d",&TRACE);
-
-
-  srand(9999);              /* init random number generator */
-  sum = 0.0;                /* test random number generator for students */
-  for (i=0; i<1000; i++)
-    sum+=jimsrand();    /* jimsrand() should be uniform in [0,1] */
-  avg = sum/1000.0;
-  if (avg < 0.25 || avg > 0.75) {
-    printf("It is likely that random number generation on your machine\n" ); 
-    printf("is different from what this emulator expects.  Please take\n");
-    printf("a look at the routine jimsrand() in the emulator code. Sorry. \n");
-    exit(EXIT_FAILURE);
-  }
-
-  /* initialise statistics */
-  window_full = 0;
-  total_ACKs_received = 0;
-  packets_resent = 0;
-  new_ACKs = 0;
-  packets_received = 0;
-  packets_lost = 0;  
-  packets_corrupt = 0;
-  packets_sent = 0;
-  packets_timeout = 0;
-  messages_delivered = 0;
-
-  ntolayer3 = 0;
-  nlost = 0;
-  ncorrupt = 0;
-
-  time=0.0;                    /* initialize time to 0.0 */
-  generate_next_arrival();     /* initialize event list */
+  scanf("%d",&p->trace);
 }
 
 /********************** Student-callable ROUTINES ***********************/
 
+/* The timer warnings below report a bug in the protocol, so they go to
+   stderr at any trace level, and never into the trace or a sweep's rows. */
+
 /* called by students routine to cancel a previously-started timer */
-void stoptimer(int AorB)
+void stoptimer(struct sim *sim, int AorB)
 /* A or B is trying to stop timer */
 {
-  struct event *q;
-
-  if (TRACE>1)
-    printf("          STOP TIMER: stopping timer at %f\n",time);
-  /* for (q=evlist; q!=NULL && q->next!=NULL; q = q->next)  */
-  for (q=evlist; q!=NULL ; q = q->next) 
-    if ( (q->evtype==TIMER_INTERRUPT  && q->eventity==AorB) ) { 
-      /* remove this event */
-      if (q->next==NULL && q->prev==NULL)
-        evlist=NULL;         /* remove first and only event on list */
-      else if (q->next==NULL) /* end of list - there is one in front */
-        q->prev->next = NULL;
-      else if (q==evlist) { /* front of list - there must be event after */
-        q->next->prev=NULL;
-        evlist = q->next;
-      }
-      else {     /* middle of list */
-        q->next->prev = q->prev;
-        q->prev->next =  q->next;
-      }
-      free(q);
-      return;
-    }
-  printf("Warning: unable to cancel your timer. It wasn't running.\n");
+  if (TRACE_LEVEL(sim) > 1)
+    trace_printf(sim, "          STOP TIMER: stopping timer at %f\n",sim->time);
+  record_call(sim, REC_STOP, AorB, FATE_OK, 0.0, NULL);
+  if (sim->timers[AorB] == NULL) {
+    fprintf(stderr, "Warning: unable to cancel your timer. It wasn't running.\n");
+    return;
+  }
+  if (!sim->replaying)
+    eventq_cancel(&sim->evlist, sim->timers[AorB]);
+  sim->timers[AorB] = NULL;
 }
 
 
-void starttimer(int AorB, double increment)
+void starttimer(struct sim *sim, int AorB, double increment)
 /* A or B is trying to start timer */
 {
-
-  struct event *q;
   struct event *evptr;
 
-  if (TRACE>1)
-    printf("          START TIMER: starting timer at %f\n",time);
+  if (TRACE_LEVEL(sim) > 1)
+    trace_printf(sim, "          START TIMER: starting timer at %f\n",sim->time);
+  record_call(sim, REC_START, AorB, FATE_OK, increment, NULL);
   /* be nice: check to see if timer is already started, if so, then  warn */
-  /* for (q=evlist; q!=NULL && q->next!=NULL; q = q->next)  */
-  for (q=evlist; q!=NULL ; q = q->next)  
-    if ( (q->evtype==TIMER_INTERRUPT  && q->eventity==AorB) ) { 
-      printf("Warning: attempt to start a timer that is already started\n");
-      return;
-    }
+  if (sim->timers[AorB] != NULL) {
+    fprintf(stderr, "Warning: attempt to start a timer that is already started\n");
+    return;
+  }
+  if (sim->replaying) {         /* the record says when it goes off */
+    sim->timers[AorB] = &sim->replaytimer;
+    return;
+  }
  
   /* create future event for when timer goes off */
-  evptr = malloc(sizeof(struct event));
-  if (evptr == 0) {
-    printf("memory allocation for event failed.");
-    exit(EXIT_FAILURE);
-  }
-  evptr->evtime =  time + increment;
+  evptr = eventq_alloc(&sim->evlist);
+  evptr->evtime =  sim->time + increment;
   evptr->evtype =  TIMER_INTERRUPT;
    
  
   evptr->eventity = AorB;
-  insertevent(evptr);
+  insertevent(sim, evptr);
+  sim->timers[AorB] = evptr;
 } 
 
 
 /************************** TOLAYER3 ***************/
-void tolayer3(int AorB, struct pkt packet)
+void tolayer3(struct sim *sim, int AorB, struct pkt packet)
 /* A or B is sending to network  */
 {
   struct pkt *mypktptr;
-  struct event *evptr,*q;
-  float lastime, x;
-  int i;
+  struct event *evptr;
+  struct channel *ch = &sim->channels[(AorB+1) % 2];
+  float lastime, x, arrival = 0.0;
+  int corruptdirection = sim->params.corruptdirection;
+  int i, lost;
+
+  sim->stats.ntolayer3++;
+  if (AorB == A)
+    sim->stats.ntolayer3_ab++;
+  else
+    sim->stats.ntolayer3_ba++;
 
-  ntolayer3++;
+  if (sim->replaying) {         /* the record says what arrives where */
+    record_call(sim, REC_SEND, AorB, FATE_REPLAYED, 0.0, &packet);
+    return;
+  }
 
   /* simulate losses: */
-  if (jimsrand() < lossprob && (!(AorB == B && corruptdirection == A) && !(AorB == A && corruptdirection == B))) {
-    nlost++;
-    if (TRACE>0)    
-      printf("          TOLAYER3: packet being lost\n");
+  if (ch->link.lossmodel == LOSS_BERNOULLI)
+    lost = jimsrand(sim) < sim->params.lossprob && (!(AorB == B && corruptdirection == A) && !(AorB == A && corruptdirection == B));
+  else
+    lost = channel_lost(ch, &sim->rng);
+  channel_count_loss(ch, lost);
+  if (lost) {
+    sim->stats.nlost++;
+    record_call(sim, REC_SEND, AorB, FATE_LOST, 0.0, &packet);
+    if (TRACE_LEVEL(sim) > 0)    
+      trace_printf(sim, "          TOLAYER3: packet being lost\n");
     return;
   }  
 
+  /* a link queues the packet behind those it has yet to send, or drops
+     it if the queue is full */
+  if (channel_is_link(ch)) {
+    arrival = channel_transmit(ch, sim->time,
+                               ch->link.aqm == LINK_RED ? jimsrand(sim) : 0.0);
+    if (arrival < 0.0) {
+      sim->stats.nlost++;
+      record_call(sim, REC_SEND, AorB, FATE_LOST, 0.0, &packet);
+      if (TRACE_LEVEL(sim) > 0)
+        trace_printf(sim, "          TOLAYER3: packet dropped by the link queue\n");
+      return;
+    }
+  }
+
   /* make a copy of the packet student just gave me since he/she may decide */
   /* to do something with the packet after we return back to him/her */ 
-  mypktptr = malloc(sizeof(struct pkt));
-  if (mypktptr == 0) {
-    printf("memory allocation for event failed.");
-    exit(EXIT_FAILURE);
-  }
+  evptr = eventq_alloc(&sim->evlist);
+  mypktptr = &evptr->pkt;
   mypktptr->seqnum = packet.seqnum;
   mypktptr->acknum = packet.acknum;
   mypktptr->checksum = packet.checksum;
   for (i=0; i<20; i++)
     mypktptr->payload[i] = packet.payload[i];
-  if (TRACE>2)  {
-    printf("          TOLAYER3: seq: %d, ack %d, check: %d ", mypktptr->seqnum,
+  if (TRACE_LEVEL(sim) > 2)  {
+    trace_printf(sim, "          TOLAYER3: seq: %d, ack %d, check: %d ", mypktptr->seqnum,
            mypktptr->acknum,  mypktptr->checksum);
-    for (i=0; i<20; i++)
-      printf("%c",mypktptr->payload[i]);
-    printf("\n");
+    trace_write(sim, mypktptr->payload, 20);
+    trace_printf(sim, "\n");
   }
 
   /* create future event for arrival of packet at the other side */
-  evptr = malloc(sizeof(struct event));
-  if (evptr == 0) {
-    printf("memory allocation for event failed.");
-    exit(EXIT_FAILURE);
-  }
   evptr->evtype =  FROM_LAYER3;   /* packet will pop out from layer3 */
   evptr->eventity = (AorB+1) % 2; /* event occurs at other entity */
-  evptr->pktptr = mypktptr;       /* save ptr to my copy of packet */
   /* finally, compute the arrival time of packet at the other end.
-     medium can not reorder, so make sure packet arrives between 1 and 10
-     time units after the latest arrival time of packets
-     currently in the medium on their way to the destination */
-  lastime = time;
-  /* for (q=evlist; q!=NULL && q->next!=NULL; q = q->next) */
-  for (q=evlist; q!=NULL ; q = q->next) 
-    if ( (q->evtype==FROM_LAYER3  && q->eventity==evptr->eventity) ) 
-      lastime = q->evtime;
-  evptr->evtime =  lastime + 1 + 9*jimsrand();
+     unless set to reorder, medium can not reorder, so make sure packet
+     arrives between 1 and 10 time units after the latest arrival time of
+     packets currently in the medium on their way to the destination */
+  if (channel_is_link(ch))
+    evptr->evtime = arrival;
+  else {
+    if (ch->link.reorder > 0.0 && jimsrand(sim) < ch->link.reorder)
+      lastime = channel_reorder_tail(ch, sim->time);
+    else
+      lastime = channel_tail(ch, sim->time);
+    if (ch->link.delaydist == DELAY_UNIFORM)
+      evptr->evtime =  lastime + ch->link.delaymin + (ch->link.delaymax - ch->link.delaymin)*jimsrand(sim);
+    else
+      evptr->evtime =  lastime + channel_delay(ch, &sim->rng);
+    ch->ndelayed++;
+    ch->delaysum += evptr->evtime - lastime;
+  }
+  channel_scheduled(ch, evptr->evtime);
+  evptr->fate = FATE_OK;
  
 
 
   /* simulate corruption: */
-  if ((jimsrand() < corruptprob)  && (!(AorB == B && corruptdirection == A) && !(AorB == A && corruptdirection == B))) {
-    ncorrupt++;
-    if ( (x = jimsrand()) < .75)
+  if ((jimsrand(sim) < sim->params.corruptprob)  && (!(AorB == B && corruptdirection == A) && !(AorB == A && corruptdirection == B))) {
+    sim->stats.ncorrupt++;
+    if ( (x = jimsrand(sim)) < .75) {
       mypktptr->payload[0]='Z';   /* corrupt payload */
-    else if (x < .875)
+      evptr->fate = FATE_PAYLOAD;
+    }
+    else if (x < .875) {
       mypktptr->seqnum = 999999;
-    else
+      evptr->fate = FATE_SEQNUM;
+    }
+    else {
       mypktptr->acknum = 999999;
-    if (TRACE>0)    
-      printf("          TOLAYER3: packet being corrupted\n");
+      evptr->fate = FATE_ACKNUM;
+    }
+    if (TRACE_LEVEL(sim) > 0)    
+      trace_printf(sim, "          TOLAYER3: packet being corrupted\n");
   }  
 
-  if (TRACE>2)  
-    printf("          TOLAYER3: scheduling arrival on other side\n");
-  insertevent(evptr);
+  if (TRACE_LEVEL(sim) > 2)  
+    trace_printf(sim, "          TOLAYER3: scheduling arrival on other side\n");
+  record_call(sim, REC_SEND, AorB, evptr->fate, evptr->evtime, &packet);
+  insertevent(sim, evptr);
 } 
 
-void tolayer5(int AorB, char datasent[20])
+void tolayer5(struct sim *sim, int AorB, char datasent[20])
 {
-  int i;  
-  if (TRACE>2) {
-    printf("          TOLAYER5: data received by application at ");
+  const struct genmsg *gen;
+  int i;
+
+  if (TRACE_LEVEL(sim) > 2) {
+    trace_printf(sim, "          TOLAYER5: data received by application at ");
     if (AorB == A) 
-      printf("A: ");
+      trace_printf(sim, "A: ");
     else
-      printf("B: ");
-    for (i=0; i<20; i++)  
-      printf("%c",datasent[i]);
-    printf("\n");
+      trace_printf(sim, "B: ");
+    trace_write(sim, datasent, 20);
+    trace_printf(sim, "\n");
+  }
+  if (sim->rec != NULL) {
+    struct pkt delivered;
+    memset(&delivered, 0, sizeof(delivered));
+    memcpy(delivered.payload, datasent, 20);
+    record_call(sim, REC_DELIVER, AorB, FATE_OK, 0.0, &delivered);
+  }
+  sim->stats.messages_delivered++;
+
+  /* B must deliver in order what A took in order, so the oldest message
+     waiting is this one, and its time gives the latency */
+  if (AorB == B) {
+    if (sim->gencount == 0) {
+      sim->stats.misdelivered++;
+      return;
+    }
+    gen = &sim->gen[sim->genhead];
+    for (i = 0; i < 20 && datasent[i] == gen->data; i++)
+      ;
+    if (i < 20)
+      sim->stats.misdelivered++;
+    hist_add(&sim->latency, sim->time - gen->time);
+    sim->genhead = (sim->genhead + 1) % sim->gencap;
+    sim->gencount--;
+  }
+}
+
+/* note that A has taken a message from layer 5 generated now */
+static void genmsg_put(struct sim *sim, const struct msg *message)
+{
+  struct genmsg *grown;
+  int i;
+
+  if (sim->gencount == sim->gencap) {
+    grown = malloc(2 * sim->gencap * sizeof(struct genmsg));
+    if (grown == NULL) {
+      printf("memory allocation for message times failed.");
+      exit(EXIT_FAILURE);
+    }
+    for (i = 0; i < sim->gencount; i++)
+      grown[i] = sim->gen[(sim->genhead + i) % sim->gencap];
+    free(sim->gen);
+    sim->gen = grown;
+    sim->gencap *= 2;
+    sim->genhead = 0;
   }
-  messages_delivered++;
+  i = (sim->genhead + sim->gencount++) % sim->gencap;
+  sim->gen[i].time = sim->time;
+  sim->gen[i].data = message->data[0];
 }
 
-int main(void)
+/* give A a message from layer 5, remembering it if A takes it rather
+   than dropping it on a full window */
+static void layer5_to_A(struct sim *sim, struct msg message)
+{
+  int dropped = sim->stats.window_full;
+
+  sim->proto->A_output(sim, message);
+  if (sim->stats.window_full == dropped)
+    genmsg_put(sim, &message);
+}
+
+/* the samples up to the end of the run, written to the samplelog */
+static void sim_sample_end(struct sim *sim)
+{
+  sampler_until(sim, sim->time);
+  sampler_write(&sim->sampler, sim->params.samplelog, sim->params.sampleformat);
+}
+
+void sim_run(struct sim *sim)
 {
   struct event *eventptr;
   struct msg  msg2give;
@@ -397,82 +550,471 @@ int main(void)
    
   int i,j;
   
-  init();
-  A_init();
-  B_init();
-   
   while (1) {
-    eventptr = evlist;            /* get next event to simulate */
-    if (eventptr==NULL)
-      goto terminate;
-    evlist = evlist->next;        /* remove this event from event list */
-    if (evlist!=NULL)
-      evlist->prev=NULL;
-    if (TRACE>=2) {
-      printf("\nEVENT time: %f,",eventptr->evtime);
-      printf("  type: %d",eventptr->evtype);
+    eventptr = eventq_pop(&sim->evlist);   /* get next event to simulate */
+    if (eventptr==NULL) {
+      if (sim->sampler.interval > 0.0)
+        sim_sample_end(sim);
+      trace_flush(&sim->tsink);
+      return;
+    }
+    if (sim->sampler.interval > 0.0)
+      sampler_until(sim, eventptr->evtime);
+    if (TRACE_LEVEL(sim) >= 2) {
+      trace_printf(sim, "\nEVENT time: %f,",eventptr->evtime);
+      trace_printf(sim, "  type: %d",eventptr->evtype);
       if (eventptr->evtype==0)
-        printf(", timerinterrupt  ");
+        trace_printf(sim, ", timerinterrupt  ");
       else if (eventptr->evtype==1)
-        printf(", fromlayer5 ");
+        trace_printf(sim, ", fromlayer5 ");
       else
-        printf(", fromlayer3 ");
-      printf(" entity: %d\n",eventptr->eventity);
+        trace_printf(sim, ", fromlayer3 ");
+      trace_printf(sim, " entity: %d\n",eventptr->eventity);
     }
-    time = eventptr->evtime;        /* update time to next event time */
+    sim->time = eventptr->evtime;        /* update time to next event time */
+    sim->stats.events++;
     if (eventptr->evtype == FROM_LAYER5 ) {
-      if (nsim < nsimmax) {
-        generate_next_arrival();   /* set up future arrival */
+      if (sim->nsim < sim->params.nsimmax) {
+        generate_next_arrival(sim);   /* set up future arrival */
         /* fill in msg to give with string of same letter */    
-        j = nsim % 26; 
+        j = sim->nsim % 26; 
         for (i=0; i<20; i++)  
           msg2give.data[i] = 97 + j;
-        if (TRACE>2) {
-          printf("          MAINLOOP: data given to student: ");
-          for (i=0; i<20; i++) 
-            printf("%c", msg2give.data[i]);
-          printf("\n");
+        if (TRACE_LEVEL(sim) > 2) {
+          trace_printf(sim, "          MAINLOOP: data given to student: ");
+          trace_write(sim, msg2give.data, 20);
+          trace_printf(sim, "\n");
+        }
+        sim->nsim++;
+        if (sim->rec != NULL) {
+          memcpy(pkt2give.payload, msg2give.data, 20);
+          pkt2give.seqnum = pkt2give.acknum = pkt2give.checksum = 0;
+          record_call(sim, REC_LAYER5, eventptr->eventity, FATE_OK, 0.0, &pkt2give);
         }
-        nsim++;
         if (eventptr->eventity == A) 
-          A_output(msg2give);  
+          layer5_to_A(sim, msg2give);
         else
-          B_output(msg2give);  
+          sim->proto->B_output(sim, msg2give);  
       }
-      else if (TRACE > 2)
-          printf("          FROM_LAYER5: no more messages to send: \n");
+      else if (TRACE_LEVEL(sim) > 2)
+          trace_printf(sim, "          FROM_LAYER5: no more messages to send: \n");
     }
     else if (eventptr->evtype ==  FROM_LAYER3) {
-      pkt2give.seqnum = eventptr->pktptr->seqnum;
-      pkt2give.acknum = eventptr->pktptr->acknum;
-      pkt2give.checksum = eventptr->pktptr->checksum;
+      pkt2give.seqnum = eventptr->pkt.seqnum;
+      pkt2give.acknum = eventptr->pkt.acknum;
+      pkt2give.checksum = eventptr->pkt.checksum;
       for (i=0; i<20; i++)  
-        pkt2give.payload[i] = eventptr->pktptr->payload[i];
+        pkt2give.payload[i] = eventptr->pkt.payload[i];
+      record_call(sim, REC_LAYER3, eventptr->eventity, eventptr->fate, 0.0, &pkt2give);
 	    if (eventptr->eventity ==A)      /* deliver packet by calling */
-        A_input(pkt2give);            /* appropriate entity */
+        sim->proto->A_input(sim, pkt2give);       /* appropriate entity */
       else
-        B_input(pkt2give);
-	    free(eventptr->pktptr);          /* free the memory for packet */
+        sim->proto->B_input(sim, pkt2give);
     }
     else if (eventptr->evtype ==  TIMER_INTERRUPT) {
+      sim->timers[eventptr->eventity] = NULL;   /* timer has gone off */
+      record_call(sim, REC_TIMER, eventptr->eventity, FATE_OK, 0.0, NULL);
       if (eventptr->eventity == A) 
-        A_timerinterrupt();
+        sim->proto->A_timerinterrupt(sim);
       else
-        B_timerinterrupt();
+        sim->proto->B_timerinterrupt(sim);
     }
     else  {
-      printf("INTERNAL PANIC: unknown event type \n");
+      trace_printf(sim, "INTERNAL PANIC: unknown event type \n");
+    }
+    eventq_release(&sim->evlist, eventptr);   /* return event and packet to the pool */
+  }
+}
+
+int sim_replay(struct sim *sim, const char *path)
+{
+  struct record rec;
+  struct msg msg2give;
+  struct pkt pkt2give;
+  FILE *in;
+
+  in = record_open(path);
+  if (in == NULL)
+    return -1;
+  sim->replaying = 1;
+  while (record_get(in, &rec)) {
+    if (rec.kind > REC_LAYER3)
+      continue;                 /* calls made by the protocol, it makes them again */
+    if (sim->sampler.interval > 0.0)
+      sampler_until(sim, rec.time);
+    sim->time = rec.time;
+    sim->stats.events++;
+    if (sim->rec != NULL)
+      record_put(sim->rec, &rec);
+    pkt2give.seqnum = rec.seqnum;
+    pkt2give.acknum = rec.acknum;
+    pkt2give.checksum = rec.checksum;
+    memcpy(pkt2give.payload, rec.payload, 20);
+    memcpy(msg2give.data, rec.payload, 20);
+    if (rec.kind == REC_LAYER5) {
+      sim->nsim++;
+      if (rec.entity == A)
+        layer5_to_A(sim, msg2give);
+      else
+        sim->proto->B_output(sim, msg2give);
+    }
+    else if (rec.kind == REC_LAYER3) {
+      if (rec.entity == A)
+        sim->proto->A_input(sim, pkt2give);
+      else
+        sim->proto->B_input(sim, pkt2give);
+    }
+    else {
+      sim->timers[rec.entity] = NULL;
+      if (rec.entity == A)
+        sim->proto->A_timerinterrupt(sim);
+      else
+        sim->proto->B_timerinterrupt(sim);
+    }
+  }
+  fclose(in);
+  if (sim->sampler.interval > 0.0)
+    sim_sample_end(sim);
+  trace_flush(&sim->tsink);
+  return 0;
+}
+
+/* the congestion window averaged over the run */
+static double sim_mean_cwnd(const struct sim *sim)
+{
+  const struct sim_stats *st = &sim->stats;
+
+  if (sim->time <= 0.0)
+    return st->cwnd_last;
+  return (st->cwnd_area + st->cwnd_last * (sim->time - st->cwnd_since)) / sim->time;
+}
+
+/* the names of the LOSS_ and DELAY_ models, as the parameters give them */
+static const char *const loss_names[] = {"bernoulli", "ge", "trace"};
+static const char *const delay_names[] = {"uniform", "exp", "pareto", "empirical"};
+
+static void report_channel(FILE *out, const char *name, const struct channel *ch)
+{
+  fprintf(out, "channel %s: loss %s, %d lost in %d bursts, longest %d; delay %s",
+          name, loss_names[ch->link.lossmodel], ch->lost, ch->bursts, ch->burst_max,
+          delay_names[ch->link.delaydist]);
+  if (!channel_is_link(ch))
+    fprintf(out, ", mean %f", ch->ndelayed ? ch->delaysum / ch->ndelayed : 0.0);
+  if (ch->link.reorder > 0.0)
+    fprintf(out, "; %d reordered (probability %f, depth %d)", ch->reordered,
+            ch->link.reorder, ch->link.reorderdepth);
+  fprintf(out, " \n");
+}
+
+/* the share of the run a link spent sending */
+static double channel_utilisation(const struct channel *ch, float time)
+{
+  return time > 0.0 ? ch->busytime / time : 0.0;
+}
+
+static void report_link(const struct sim *sim, FILE *out, const char *name,
+                        const struct channel *ch)
+{
+  fprintf(out, "link %s: bandwidth %f, delay %f, queue %d%s: %d packets sent, %d dropped by the queue",
+          name, ch->link.bandwidth, ch->link.delay, ch->link.queue,
+          ch->link.aqm == LINK_RED ? " (red)" : "", ch->sent, ch->drops);
+  if (ch->link.aqm == LINK_RED)
+    fprintf(out, ", %d early", ch->early_drops);
+  fprintf(out, ", mean queue wait %f, max %f, utilisation %f \n",
+          ch->sent ? ch->wait / ch->sent : 0.0, ch->wait_max,
+          channel_utilisation(ch, sim->time));
+}
+
+void sim_report(const struct sim *sim, FILE *out)
+{
+  const struct sim_stats *st = &sim->stats;
+
+  fprintf(out, " Simulator terminated at time %f\n after attempting to send %d msgs from layer5\n",sim->time,sim->nsim);
+  fprintf(out, "number of messages dropped due to full window:  %d \n", st->window_full);
+  if (sim->params.sendq > 0)
+    fprintf(out, "send queue: %d messages queued, %d still waiting, peak %d, mean delay %f, max delay %f \n",
+            st->queued, st->queued - st->dequeued, st->queue_peak,
+            st->dequeued ? st->queue_delay / st->dequeued : 0.0, st->queue_delay_max);
+  fprintf(out, "number of valid (not corrupt or duplicate) acknowledgements received at A:  %d \n", st->new_ACKs);
+  fprintf(out, "(note: a single acknowledgement may have acknowledged more than one packet - if cumulative acknowledgements are used)\n");
+  fprintf(out, "number of packet resends by A:  %d \n", st->packets_resent);
+  fprintf(out, "number of correct packets received at B:  %d \n", st->packets_received);
+  fprintf(out, "number of messages delivered to application:  %d \n", st->messages_delivered);
+  if (st->misdelivered > 0)
+    fprintf(out, "number of those out of order, duplicated or damaged:  %d \n", st->misdelivered);
+  fprintf(out, "number of spurious resends (packets B had already accepted):  %d \n", st->spurious_resends);
+  if (sim_params_sack(&sim->params))
+    fprintf(out, "number of packets ACKed by SACK information:  %d \n", st->sacked);
+  if (sim->params.links[A].reorder > 0.0 || sim->params.links[B].reorder > 0.0)
+    fprintf(out, "number of packets received ahead of a missing one:  %d, most held at once:  %d \n",
+            st->out_of_order, st->held_peak);
+  if (sim->params.cc[0] != '\0' && strcmp(sim->params.cc, "none") != 0)
+    fprintf(out, "congestion control (%s): mean cwnd %f, final cwnd %f, %d losses, %d timeouts \n",
+            sim->params.cc, sim_mean_cwnd(sim), st->cwnd_last, st->cc_losses, st->cc_timeouts);
+  if (sim->params.dupacks > 0)
+    fprintf(out, "number of fast retransmits:  %d, recovery time saved:  %f (%f each) \n",
+            st->fast_retransmits, st->recovery_saved,
+            st->fast_retransmits ? st->recovery_saved / st->fast_retransmits : 0.0);
+  fprintf(out, "retransmission timeout (%s): min %f, max %f, final %f, %d samples, %d backoffs \n",
+          sim->params.rto == RTO_ADAPTIVE ? "adaptive" : "fixed",
+          st->rto_min, st->rto_max, st->rto_last, st->rto_samples, st->rto_backoffs);
+  if (channel_is_modelled(&sim->channels[B]))
+    report_channel(out, "A->B", &sim->channels[B]);
+  if (channel_is_modelled(&sim->channels[A]))
+    report_channel(out, "B->A", &sim->channels[A]);
+  if (channel_is_link(&sim->channels[B]))
+    report_link(sim, out, "A->B", &sim->channels[B]);
+  if (channel_is_link(&sim->channels[A]))
+    report_link(sim, out, "B->A", &sim->channels[A]);
+  if (channel_is_link(&sim->channels[B]) || channel_is_link(&sim->channels[A]))
+    fprintf(out, "throughput: %f messages per time unit \n",
+            sim->time > 0.0 ? st->messages_delivered / sim->time : 0.0);
+  fprintf(out, "message latency: mean %f, p50 %f, p99 %f, p99.9 %f, max %f \n",
+          hist_mean(&sim->latency), hist_quantile(&sim->latency, 0.5),
+          hist_quantile(&sim->latency, 0.99), hist_quantile(&sim->latency, 0.999),
+          sim->latency.max);
+  fprintf(out, "head-of-line blocking: %d messages waited, mean %f, p99 %f, max %f \n",
+          sim->hol.n, hist_mean(&sim->hol), hist_quantile(&sim->hol, 0.99), sim->hol.max);
+  if (sim->params.ackevery > 1)
+    fprintf(out, "delayed ACKs: one per %d packets or %f time units \n",
+            sim->params.ackevery, sim->params.ackdelay);
+  fprintf(out, "events dispatched: %d, packets sent A->B: %d, B->A: %d \n",
+          st->events, st->ntolayer3_ab, st->ntolayer3_ba);
+  fprintf(out, "peak event memory: %d events, %lu bytes \n", sim->evlist.peak_inuse,
+          (unsigned long)eventq_peak_bytes(&sim->evlist));
+}
+
+void sim_write_header(FILE *out)
+{
+  fprintf(out, "protocol,messages,loss,corrupt,direction,lambda,seed,rng,rto,"
+          "window,seqspace,rtt,sack,dupacks,cc,sendq,ackevery,ackdelay,"
+          "ab_bandwidth,ab_delay,ab_queue,ab_aqm,ab_lossmodel,ab_delaydist,ab_reorder,ab_reorderdepth,"
+          "ba_bandwidth,ba_delay,ba_queue,ba_aqm,ba_lossmodel,ba_delaydist,ba_reorder,ba_reorderdepth,"
+          "end_time,nsim,window_full,total_ACKs_received,new_ACKs,packets_resent,"
+          "packets_received,messages_delivered,misdelivered,ntolayer3,nlost,ncorrupt,"
+          "events,ntolayer3_ab,ntolayer3_ba,"
+          "spurious_resends,sacked,fast_retransmits,recovery_saved,"
+          "rto_min,rto_max,rto_last,rto_samples,rto_backoffs,"
+          "mean_cwnd,cc_losses,cc_timeouts,"
+          "queued,dequeued,queue_peak,mean_queue_delay,max_queue_delay,"
+          "ab_sent,ab_drops,ab_early_drops,ab_mean_wait,ab_max_wait,ab_utilisation,"
+          "ba_sent,ba_drops,ba_early_drops,ba_mean_wait,ba_max_wait,ba_utilisation,"
+          "ab_lost,ab_loss_bursts,ab_max_burst,ab_mean_delay,ab_reordered,"
+          "ba_lost,ba_loss_bursts,ba_max_burst,ba_mean_delay,ba_reordered,"
+          "out_of_order,held_peak,"
+          "latency_mean,latency_p50,latency_p99,latency_p999,latency_max,"
+          "hol_blocked,hol_mean,hol_p99,hol_max\n");
+}
+
+void sim_write_row(const struct sim *sim, FILE *out)
+{
+  const struct sim_params *p = &sim->params;
+  const struct sim_stats *st = &sim->stats;
+  const struct channel *ch;
+  int i;
+
+  fprintf(out, "%s,%d,%g,%g,%d,%g,%u,%s,%s,%d,%d,%g,%d,%d,%s,%d,%d,%g,", sim->proto->name,
+          p->nsimmax, p->lossprob, p->corruptprob, p->corruptdirection, p->lambda, p->seed,
+          p->rng == RNG_LEGACY ? "legacy" : "xoshiro",
+          p->rto == RTO_ADAPTIVE ? "adaptive" : "fixed",
+          p->window, p->seqspace, p->rtt, sim_params_sack(p), p->dupacks,
+          p->cc[0] != '\0' ? p->cc : "none", p->sendq, p->ackevery, p->ackdelay);
+  for (i = B; i >= A; i--)      /* A->B first */
+    fprintf(out, "%g,%g,%d,%s,%s,%s,%g,%d,", p->links[i].bandwidth, p->links[i].delay,
+            p->links[i].queue, p->links[i].aqm == LINK_RED ? "red" : "droptail",
+            loss_names[p->links[i].lossmodel], delay_names[p->links[i].delaydist],
+            p->links[i].reorder, p->links[i].reorderdepth);
+  fprintf(out, "%f,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,", sim->time, sim->nsim,
+          st->window_full, st->total_ACKs_received, st->new_ACKs, st->packets_resent,
+          st->packets_received, st->messages_delivered, st->misdelivered, st->ntolayer3, st->nlost,
+          st->ncorrupt);
+  fprintf(out, "%d,%d,%d,", st->events, st->ntolayer3_ab, st->ntolayer3_ba);
+  fprintf(out, "%d,%d,%d,%f,%f,%f,%f,%d,%d,", st->spurious_resends, st->sacked,
+          st->fast_retransmits, st->recovery_saved, st->rto_min, st->rto_max,
+          st->rto_last, st->rto_samples, st->rto_backoffs);
+  fprintf(out, "%f,%d,%d,", sim_mean_cwnd(sim), st->cc_losses, st->cc_timeouts);
+  fprintf(out, "%d,%d,%d,%f,%f", st->queued, st->dequeued, st->queue_peak,
+          st->dequeued ? st->queue_delay / st->dequeued : 0.0, st->queue_delay_max);
+  for (i = B; i >= A; i--) {
+    ch = &sim->channels[i];
+    fprintf(out, ",%d,%d,%d,%f,%f,%f", ch->sent, ch->drops, ch->early_drops,
+            ch->sent ? ch->wait / ch->sent : 0.0, ch->wait_max,
+            channel_utilisation(ch, sim->time));
+  }
+  for (i = B; i >= A; i--) {
+    ch = &sim->channels[i];
+    fprintf(out, ",%d,%d,%d,%f,%d", ch->lost, ch->bursts, ch->burst_max,
+            ch->ndelayed ? ch->delaysum / ch->ndelayed : 0.0, ch->reordered);
+  }
+  fprintf(out, ",%d,%d", st->out_of_order, st->held_peak);
+  fprintf(out, ",%f,%f,%f,%f,%f", hist_mean(&sim->latency), hist_quantile(&sim->latency, 0.5),
+          hist_quantile(&sim->latency, 0.99), hist_quantile(&sim->latency, 0.999),
+          sim->latency.max);
+  fprintf(out, ",%d,%f,%f,%f\n", sim->hol.n, hist_mean(&sim->hol),
+          hist_quantile(&sim->hol, 0.99), sim->hol.max);
+}
+
+static void usage(const char *prog)
+{
+  int i;
+
+  fprintf(stderr, "usage: %s [options]\n", prog);
+  fprintf(stderr, "With no run parameters the emulator prompts for them.\n");
+  fprintf(stderr, "  -n, --messages N      number of messages to simulate\n");
+  fprintf(stderr, "  -l, --loss P          packet loss probability\n");
+  fprintf(stderr, "  -c, --corrupt P       packet corruption probability\n");
+  fprintf(stderr, "  -d, --direction D     loss/corruption direction: 0 A->B, 1 A<-B, 2 both\n");
+  fprintf(stderr, "  -L, --lambda T        average time between messages from layer 5\n");
+  fprintf(stderr, "  -t, --trace N         TRACE level\n");
+  fprintf(stderr, "  -T, --trace-file FILE write the trace to FILE instead of stdout\n");
+  fprintf(stderr, "  -R, --record FILE     write a binary record of every event to FILE\n");
+  fprintf(stderr, "  -P, --replay FILE     re-drive the protocol from a record instead of\n");
+  fprintf(stderr, "                        simulating (give the same protocol parameters)\n");
+  fprintf(stderr, "  -s, --seed N          random number generator seed\n");
+  fprintf(stderr, "  -r, --rng NAME        xoshiro or legacy (the original rand() stream)\n");
+  fprintf(stderr, "  -p, --protocol NAME   protocol to run:");
+  for (i = 0; protocols[i] != NULL; i++)
+    fprintf(stderr, "%s %s%s", i > 0 ? "," : "", protocols[i]->name,
+            i == 0 ? " (default)" : "");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "  -f, --config FILE     read key = value parameters from FILE\n");
+  fprintf(stderr, "  -D, --set KEY=VALUE   set any parameter by name\n");
+  fprintf(stderr, "  -S, --sweep GRID      run every combination in a sweep grid\n");
+  fprintf(stderr, "  -o, --out FILE        write sweep results to FILE\n");
+  fprintf(stderr, "  -j, --threads N       sweep worker threads (default: one per CPU)\n");
+  fprintf(stderr, "Options are applied in order, so later ones override a config file.\n");
+}
+
+int main(int argc, char **argv)
+{
+  static const struct option options[] = {
+    {"messages",  required_argument, NULL, 'n'},
+    {"loss",      required_argument, NULL, 'l'},
+    {"corrupt",   required_argument, NULL, 'c'},
+    {"direction", required_argument, NULL, 'd'},
+    {"lambda",    required_argument, NULL, 'L'},
+    {"trace",     required_argument, NULL, 't'},
+    {"trace-file", required_argument, NULL, 'T'},
+    {"record",    required_argument, NULL, 'R'},
+    {"replay",    required_argument, NULL, 'P'},
+    {"seed",      required_argument, NULL, 's'},
+    {"rng",       required_argument, NULL, 'r'},
+    {"protocol",  required_argument, NULL, 'p'},
+    {"config",    required_argument, NULL, 'f'},
+    {"set",       required_argument, NULL, 'D'},
+    {"sweep",     required_argument, NULL, 'S'},
+    {"out",       required_argument, NULL, 'o'},
+    {"threads",   required_argument, NULL, 'j'},
+    {"help",      no_argument,       NULL, 'h'},
+    {NULL, 0, NULL, 0}
+  };
+  struct sim_params params;
+  struct sim *sim;
+  const char *gridfile = NULL, *outfile = NULL, *replayfile = NULL;
+  const char *key, *err;
+  char *eq;
+  int nthreads = 0;
+  int interactive = 1;    /* prompt unless some parameter was given */
+  FILE *out;
+  int c, status;
+
+  sim_params_default(&params);
+  while ((c = getopt_long(argc, argv, "n:l:c:d:L:t:T:R:P:s:r:p:f:D:S:o:j:h", options, NULL)) != -1) {
+    key = NULL;
+    switch (c) {
+    case 'n': key = "messages"; break;
+    case 'l': key = "loss"; break;
+    case 'c': key = "corrupt"; break;
+    case 'd': key = "direction"; break;
+    case 'L': key = "lambda"; break;
+    case 't': key = "trace"; break;
+    case 'T': key = "tracefile"; break;
+    case 'R': key = "record"; break;
+    case 'P': replayfile = optarg; break;
+    case 's': key = "seed"; break;
+    case 'r': key = "rng"; break;
+    case 'p':           /* picks what runs, the prompts still ask how */
+      if (sim_params_set(&params, "protocol", optarg) < 0) {
+        fprintf(stderr, "bad value for --protocol: %s\n", optarg);
+        return EXIT_FAILURE;
+      }
+      break;
+    case 'f':
+      if (sim_params_load(&params, optarg) < 0)
+        return EXIT_FAILURE;
+      interactive = 0;
+      break;
+    case 'D':
+      if ((eq = strchr(optarg, '=')) == NULL) {
+        fprintf(stderr, "--set expects KEY=VALUE, got %s\n", optarg);
+        return EXIT_FAILURE;
+      }
+      *eq = '\0';
+      if (sim_params_set(&params, optarg, eq + 1) < 0) {
+        fprintf(stderr, "bad value for %s: %s\n", optarg, eq + 1);
+        return EXIT_FAILURE;
+      }
+      interactive = 0;
+      break;
+    case 'S': gridfile = optarg; break;
+    case 'o': outfile = optarg; break;
+    case 'j': nthreads = atoi(optarg); break;
+    case 'h':
+      usage(argv[0]);
+      return EXIT_SUCCESS;
+    default:
+      usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+    if (key != NULL) {
+      if (sim_params_set(&params, key, optarg) < 0) {
+        fprintf(stderr, "bad value for --%s: %s\n", key, optarg);
+        return EXIT_FAILURE;
+      }
+      interactive = 0;
     }
-    free(eventptr);
+  }
+  if (optind < argc) {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  if (protocol_find(params.protocol) == NULL) {
+    fprintf(stderr, "unknown protocol %s\n", params.protocol);
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  if (gridfile != NULL) {
+    out = outfile ? fopen(outfile, "w") : stdout;
+    if (out == NULL) {
+      fprintf(stderr, "cannot open %s\n", outfile);
+      return EXIT_FAILURE;
+    }
+    status = sweep_run(gridfile, &params, out, nthreads);
+    if (out != stdout)
+      fclose(out);
+    return status == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
   }
 
- terminate:
-  printf(" Simulator terminated at time %f\n after attempting to send %d msgs from layer5\n",time,nsim);
-  printf("number of messages dropped due to full window:  %d \n", window_full);
-  printf("number of valid (not corrupt or duplicate) acknowledgements received at A:  %d \n", new_ACKs);
-  printf("(note: a single acknowledgement may have acknowledged more than one packet - if cumulative acknowledgements are used)\n");
-  printf("number of packet resends by A:  %d \n", packets_resent);
-  printf("number of correct packets received at B:  %d \n", packets_received);
-  printf("number of messages delivered to application:  %d \n", messages_delivered);
+  if (interactive && replayfile == NULL)
+    init(&params);
+  if ((err = sim_params_check(&params)) != NULL) {
+    fprintf(stderr, "invalid parameters: %s\n", err);
+    return EXIT_FAILURE;
+  }
+  sim = sim_create(&params);
+  if (sim == NULL)
+    return EXIT_FAILURE;
+  if (replayfile != NULL) {
+    if (sim_replay(sim, replayfile) < 0) {
+      sim_free(sim);
+      return EXIT_FAILURE;
+    }
+  }
+  else
+    sim_run(sim);
+  sim_report(sim, stdout);
+  sim_free(sim);
   return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
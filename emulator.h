@@ -1,11 +1,9 @@
-extern int TRACE;
+#ifndef EMULATOR_H
+#define EMULATOR_H
 
-/* statistics updated by GBN */
-extern int total_ACKs_received;
-extern int packets_resent;       /* count of the number of packets resent  */
-extern int new_ACKs;      /* count of the number of acks correctly received */
-extern int packets_received;  /* count of the packets received by receiver */
-extern int window_full; /* count of the number of messages dropped due to full window */
+/* every routine below works on one simulation, passed as the first
+   argument; see sim.h */
+struct sim;
 
 #define   A    0
 #define   B    1
@@ -28,13 +26,15 @@ struct pkt {
 };
 
 /* send to A or B (int), packet to send */
-extern void tolayer3(int, struct pkt);  
+extern void tolayer3(struct sim *, int, struct pkt);  
 
 /* deliver to A or B (int), data to deliver */
-extern void tolayer5(int, char[20]); 
+extern void tolayer5(struct sim *, int, char[20]); 
 
 /* start timer at A or B (int), increment */
-extern void starttimer(int, double);       
+extern void starttimer(struct sim *, int, double);       
 
 /* stop timer at A or B (int) */
-extern void stoptimer(int);               
+extern void stoptimer(struct sim *, int);               
+
+#endif
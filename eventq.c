@@ -0,0 +1,187 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include "eventq.h"
+
+#define INITIAL_CAPACITY 64
+#define CHUNK_EVENTS 1024     /* events allocated at a time by the pool */
+
+struct eventchunk {
+  struct eventchunk *next;
+  struct event events[CHUNK_EVENTS];
+};
+
+/* true if event a must be dispatched before event b */
+static int before(const struct event *a, const struct event *b)
+{
+  if (a->evtime != b->evtime)
+    return a->evtime < b->evtime;
+  return a->evseq > b->evseq;   /* newest first on equal times */
+}
+
+static void siftup(struct eventq *q, int i)
+{
+  struct event *ev = q->heap[i];
+  int parent;
+
+  while (i > 0) {
+    parent = (i - 1) / 2;
+    if (!before(ev, q->heap[parent]))
+      break;
+    q->heap[i] = q->heap[parent];
+    i = parent;
+  }
+  q->heap[i] = ev;
+}
+
+static void siftdown(struct eventq *q, int i)
+{
+  struct event *ev = q->heap[i];
+  int child;
+
+  while ((child = 2*i + 1) < q->size) {
+    if (child + 1 < q->size && before(q->heap[child+1], q->heap[child]))
+      child++;
+    if (!before(q->heap[child], ev))
+      break;
+    q->heap[i] = q->heap[child];
+    i = child;
+  }
+  q->heap[i] = ev;
+}
+
+static void refill(struct eventq *q)
+{
+  struct eventchunk *chunk;
+  int i;
+
+  chunk = malloc(sizeof(struct eventchunk));
+  if (chunk == NULL) {
+    printf("memory allocation for event failed.");
+    exit(EXIT_FAILURE);
+  }
+  chunk->next = q->chunks;
+  q->chunks = chunk;
+  q->nchunks++;
+  for (i = CHUNK_EVENTS - 1; i >= 0; i--) {
+    chunk->events[i].nextfree = q->freelist;
+    q->freelist = &chunk->events[i];
+  }
+}
+
+/* drop every cancelled event and rebuild the heap from what is left */
+static void compact(struct eventq *q)
+{
+  int i, n = 0;
+
+  for (i = 0; i < q->size; i++) {
+    if (q->heap[i]->cancelled)
+      eventq_release(q, q->heap[i]);
+    else
+      q->heap[n++] = q->heap[i];
+  }
+  q->size = n;
+  q->ncancelled = 0;
+  for (i = n/2 - 1; i >= 0; i--)
+    siftdown(q, i);
+}
+
+void eventq_init(struct eventq *q)
+{
+  q->heap = NULL;
+  q->size = 0;
+  q->capacity = 0;
+  q->ncancelled = 0;
+  q->nextseq = 0;
+  q->chunks = NULL;
+  q->freelist = NULL;
+  q->nchunks = 0;
+  q->inuse = 0;
+  q->peak_inuse = 0;
+}
+
+void eventq_free(struct eventq *q)
+{
+  struct eventchunk *chunk;
+
+  while ((chunk = q->chunks) != NULL) {
+    q->chunks = chunk->next;
+    free(chunk);
+  }
+  free(q->heap);
+  eventq_init(q);
+}
+
+struct event *eventq_alloc(struct eventq *q)
+{
+  struct event *ev;
+
+  if (q->freelist == NULL)
+    refill(q);
+  ev = q->freelist;
+  q->freelist = ev->nextfree;
+  if (++q->inuse > q->peak_inuse)
+    q->peak_inuse = q->inuse;
+  return ev;
+}
+
+void eventq_release(struct eventq *q, struct event *ev)
+{
+  ev->nextfree = q->freelist;
+  q->freelist = ev;
+  q->inuse--;
+}
+
+void eventq_push(struct eventq *q, struct event *ev)
+{
+  struct event **grown;
+  int newcap;
+
+  if (q->size == q->capacity) {
+    newcap = q->capacity ? 2 * q->capacity : INITIAL_CAPACITY;
+    grown = realloc(q->heap, newcap * sizeof(struct event *));
+    if (grown == NULL) {
+      printf("memory allocation for event queue failed.");
+      exit(EXIT_FAILURE);
+    }
+    q->heap = grown;
+    q->capacity = newcap;
+  }
+  ev->evseq = q->nextseq++;
+  ev->cancelled = 0;
+  q->heap[q->size++] = ev;
+  siftup(q, q->size - 1);
+}
+
+struct event *eventq_pop(struct eventq *q)
+{
+  struct event *top;
+
+  for (;;) {
+    if (q->size == 0)
+      return NULL;
+    top = q->heap[0];
+    q->size--;
+    if (q->size > 0) {
+      q->heap[0] = q->heap[q->size];
+      siftdown(q, 0);
+    }
+    if (!top->cancelled)
+      return top;
+    q->ncancelled--;
+    eventq_release(q, top);
+  }
+}
+
+void eventq_cancel(struct eventq *q, struct event *ev)
+{
+  ev->cancelled = 1;
+  q->ncancelled++;
+  if (q->size > INITIAL_CAPACITY && q->ncancelled > q->size / 2)
+    compact(q);
+}
+
+size_t eventq_peak_bytes(const struct eventq *q)
+{
+  return (size_t)q->nchunks * sizeof(struct eventchunk)
+    + (size_t)q->capacity * sizeof(struct event *);
+}
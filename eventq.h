@@ -0,0 +1,77 @@
+#ifndef EVENTQ_H
+#define EVENTQ_H
+
+/* Pending event queue for the network emulator.
+
+   Events are kept in a binary min-heap keyed on event time, so scheduling
+   and dispatching an event are both O(log n) in the number of pending
+   events.  Events with equal times are dispatched most recently inserted
+   first, which is the order the original sorted linked list produced.
+
+   Cancelling an event is O(1): the event is only marked, stays in the heap
+   and is discarded when it reaches the top.  The heap is compacted when
+   cancelled events make up more than half of it.
+
+   Events, including the packet carried by a FROM_LAYER3 event, come from
+   a pool owned by the queue.  The pool grows in fixed-size chunks and
+   released events go on a free list, so a long run does no per-event
+   heap allocation and its memory is bounded by the peak number of
+   pending events. */
+
+#include <stddef.h>
+#include "emulator.h"
+
+/* possible events: */
+#define  TIMER_INTERRUPT 0
+#define  FROM_LAYER5     1
+#define  FROM_LAYER3     2
+
+struct event {
+  float evtime;           /* event time */
+  int evtype;             /* event type code */
+  int eventity;           /* entity where event occurs */
+  struct pkt pkt;         /* packet (if any) assoc w/ this event */
+  int fate;               /* how the medium corrupted pkt, see record.h */
+  unsigned long evseq;    /* insertion order, used to break ties on evtime */
+  int cancelled;          /* set by eventq_cancel(), never dispatched */
+  struct event *nextfree; /* link in the pool's free list */
+};
+
+struct eventchunk;        /* a block of pooled events */
+
+struct eventq {
+  struct event **heap;    /* heap[0] is the next event to dispatch */
+  int size;               /* number of pending events */
+  int capacity;           /* allocated length of heap */
+  int ncancelled;         /* cancelled events still held in heap */
+  unsigned long nextseq;  /* evseq given to the next inserted event */
+
+  struct eventchunk *chunks;  /* every block of events allocated so far */
+  struct event *freelist;     /* events ready to be reused */
+  int nchunks;
+  int inuse;                  /* events handed out and not yet released */
+  int peak_inuse;             /* high-water mark of inuse */
+};
+
+extern void eventq_init(struct eventq *q);
+extern void eventq_free(struct eventq *q);
+
+/* get an unscheduled event from the pool */
+extern struct event *eventq_alloc(struct eventq *q);
+
+/* return a popped event to the pool once it has been dispatched */
+extern void eventq_release(struct eventq *q, struct event *ev);
+
+/* schedule an event; the queue takes ownership of ev until it is popped */
+extern void eventq_push(struct eventq *q, struct event *ev);
+
+/* remove and return the next live event, or NULL when none are left */
+extern struct event *eventq_pop(struct eventq *q);
+
+/* cancel a pending event; it is released by the queue and never returned */
+extern void eventq_cancel(struct eventq *q, struct event *ev);
+
+/* bytes held by the pool and the heap at the peak of the run */
+extern size_t eventq_peak_bytes(const struct eventq *q);
+
+#endif
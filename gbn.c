@@ -3,6 +3,8 @@
 #include <stdbool.h>
 #include "emulator.h"
 #include "gbn.h"
+#include "sim.h"
+#include "msgq.h"
 
 /* ******************************************************************
    Go Back N protocol.  Adapted from J.F.Kurose
@@ -22,18 +24,15 @@
    - added GBN implementation
 **********************************************************************/
 
-#define RTT  16.0       /* round trip time.  MUST BE SET TO 16.0 when submitting assignment */
-#define WINDOWSIZE 6    /* the maximum number of buffered unacked packet
-                          MUST BE SET TO 6 when submitting assignment */
-#define SEQSPACE 7      /* the min sequence space for GBN must be at least windowsize + 1 */
 #define NOTINUSE (-1)   /* used to fill header fields that are not being used */
+#define BIDIRECTIONAL 0 /* 0 = A->B  1 = A<->B */
 
 /* generic procedure to compute the checksum of a packet.  Used by both sender and receiver
    the simulator will overwrite part of your packet with 'z's.  It will not overwrite your
    original checksum.  This procedure must generate a different checksum to the original if
    the packet is corrupted.
 */
-int ComputeChecksum(struct pkt packet)
+static int ComputeChecksum(struct pkt packet)
 {
   int checksum = 0;
   int i;
@@ -46,7 +45,7 @@ int ComputeChecksum(struct pkt packet)
   return checksum;
 }
 
-bool IsCorrupted(struct pkt packet)
+static bool IsCorrupted(struct pkt packet)
 {
   if (packet.checksum == ComputeChecksum(packet))
     return (false);
@@ -55,191 +54,351 @@ bool IsCorrupted(struct pkt packet)
 }
 
 
+/* the sender's window and the next packet must have different sequence
+   numbers, so the receiver can tell a new packet from a resent one */
+static int min_seqspace(int window)
+{
+  return window + 1;
+}
+
 /********* Sender (A) variables and functions ************/
 
-static struct pkt buffer[WINDOWSIZE];  /* array for storing packets waiting for ACK */
-static int windowfirst, windowlast;    /* array indexes of the first/last packet awaiting ACK */
-static int windowcount;                /* the number of packets currently awaiting an ACK */
-static int A_nextseqnum;               /* the next sequence number to be used by the sender */
+struct gbn_sender {
+  int windowsize;                 /* the maximum number of buffered unacked packets */
+  int seqspace;                   /* sequence numbers run from 0 to seqspace - 1 */
+  struct pkt *buffer;             /* array for storing packets waiting for ACK */
+  int windowfirst, windowlast;    /* array indexes of the first/last packet awaiting ACK */
+  int windowcount;                /* the number of packets currently awaiting an ACK */
+  int outstanding;                /* of those, the ones from windowfirst on that have
+                                     been sent since the window was last resent; the
+                                     rest wait for the congestion window to open */
+  int A_nextseqnum;               /* the next sequence number to be used by the sender */
+  float *sendtime;                /* when each packet in the window was first sent */
+  bool *resent;                   /* whether it has been sent again since */
+  struct rto rto;                 /* the retransmission timeout */
+  struct cc cc;                   /* congestion control, limits the packets outstanding */
+  struct msgq queue;              /* messages waiting for room in the window */
+  float timer_expiry;             /* when the running timer goes off */
+  int dupthresh;                  /* duplicate ACKs that trigger a fast retransmit, 0 for never */
+  int dupcount;                   /* duplicate ACKs since the last new one */
+  bool recovering;                /* packets were resent and ... */
+  int recover;                    /* ... this, the last of them, is not yet ACKed */
+};
+
+/* start A's timer, remembering when it goes off */
+static void start_timer(struct sim *sim, struct gbn_sender *s)
+{
+  s->timer_expiry = sim->time + rto_timeout(&s->rto);
+  starttimer(sim, A, rto_timeout(&s->rto));
+}
 
-/* called from layer 5 (application layer), passed the message to be sent to other side */
-void A_output(struct msg message)
+/* resend the packets of the window that are not outstanding, as many as
+   the congestion window has room for, starting the timer if none were */
+static void resend_more(struct sim *sim, struct gbn_sender *s)
+{
+  int i;
+
+  while (s->outstanding < s->windowcount && s->outstanding < cc_window(&s->cc)) {
+    i = (s->windowfirst + s->outstanding) % s->windowsize;
+
+    if (TRACE_LEVEL(sim) > 0)
+      trace_printf(sim, "---A: resending packet %d\n", s->buffer[i].seqnum);
+
+    tolayer3(sim, A, s->buffer[i]);
+    s->resent[i] = true;
+    sim->stats.packets_resent++;
+    s->recovering = true;
+    s->recover = s->buffer[i].seqnum;
+    if (s->outstanding++ == 0)
+      start_timer(sim, s);
+  }
+}
+
+/* go back to the start of the window and resend it; what the congestion
+   window does not let go now is sent by A_input() as ACKs open it */
+static void resend_window(struct sim *sim, struct gbn_sender *s)
+{
+  s->outstanding = 0;
+  resend_more(sim, s);
+}
+
+/* B answers every packet after a lost one with a duplicate ACK for the
+   packet before the window.  After dupthresh of them the window is resent
+   at once rather than when the timer goes off.  Until all the packets
+   resent are ACKed, duplicates are expected anyway -- from the packets
+   that followed the lost one, or from copies of packets B already has --
+   and are ignored, as in TCP's NewReno. */
+static void duplicate_ack(struct sim *sim, struct gbn_sender *s, int acknum, int seqfirst)
+{
+  if (acknum != (seqfirst + s->seqspace - 1) % s->seqspace || s->recovering)
+    return;
+  if (++s->dupcount < s->dupthresh)
+    return;
+  cc_loss(sim, &s->cc, s->outstanding);
+
+  if (TRACE_LEVEL(sim) > 0)
+    trace_printf(sim, "----A: %d duplicate ACKs, fast retransmit!\n", s->dupcount);
+  sim->stats.fast_retransmits++;
+  sim->stats.recovery_saved += s->timer_expiry - sim->time;
+  stoptimer(sim, A);
+  resend_window(sim, s);
+}
+
+/* send message in a new packet; the window must have room for it */
+static void send_message(struct sim *sim, struct gbn_sender *s, struct msg message)
 {
   struct pkt sendpkt;
   int i;
 
-  /* if not blocked waiting on ACK */
-  if ( windowcount < WINDOWSIZE) {
-    if (TRACE > 1)
-      printf("----A: New message arrives, send window is not full, send new messge to layer3!\n");
-
-    /* create packet */
-    sendpkt.seqnum = A_nextseqnum;
-    sendpkt.acknum = NOTINUSE;
-    for ( i=0; i<20 ; i++ )
-      sendpkt.payload[i] = message.data[i];
-    sendpkt.checksum = ComputeChecksum(sendpkt);
-
-    /* put packet in window buffer */
-    /* windowlast will always be 0 for alternating bit; but not for GoBackN */
-    windowlast = (windowlast + 1) % WINDOWSIZE;
-    buffer[windowlast] = sendpkt;
-    windowcount++;
-
-    /* send out packet */
-    if (TRACE > 0)
-      printf("Sending packet %d to layer 3\n", sendpkt.seqnum);
-    tolayer3 (A, sendpkt);
-
-    /* start timer if first packet in window */
-    if (windowcount == 1)
-      starttimer(A,RTT);
-
-    /* get next sequence number, wrap back to 0 */
-    A_nextseqnum = (A_nextseqnum + 1) % SEQSPACE;
+  /* create packet */
+  sendpkt.seqnum = s->A_nextseqnum;
+  sendpkt.acknum = NOTINUSE;
+  for ( i=0; i<20 ; i++ )
+    sendpkt.payload[i] = message.data[i];
+  sendpkt.checksum = ComputeChecksum(sendpkt);
+
+  /* put packet in window buffer */
+  /* windowlast will always be 0 for alternating bit; but not for GoBackN */
+  s->windowlast = (s->windowlast + 1) % s->windowsize;
+  s->buffer[s->windowlast] = sendpkt;
+  s->sendtime[s->windowlast] = sim->time;
+  s->resent[s->windowlast] = false;
+  s->windowcount++;
+  s->outstanding++;
+
+  /* send out packet */
+  if (TRACE_LEVEL(sim) > 0)
+    trace_printf(sim, "Sending packet %d to layer 3\n", sendpkt.seqnum);
+  tolayer3 (sim, A, sendpkt);
+
+  /* start timer if first packet in window */
+  if (s->windowcount == 1)
+    start_timer(sim, s);
+
+  /* get next sequence number, wrap back to 0 */
+  s->A_nextseqnum = (s->A_nextseqnum + 1) % s->seqspace;
+}
+
+/* true if the window has room for another packet; the congestion window
+   never exceeds windowsize, and packets waiting to be resent are counted,
+   so they go before new ones */
+static bool window_open(const struct gbn_sender *s)
+{
+  return s->windowcount < cc_window(&s->cc);
+}
+
+/* called from layer 5 (application layer), passed the message to be sent to other side */
+static void A_output(struct sim *sim, struct msg message)
+{
+  struct gbn_sender *s = sim->state[A];
+
+  /* if not blocked waiting on ACK, and no older message is waiting */
+  if (window_open(s) && msgq_empty(&s->queue)) {
+    if (TRACE_LEVEL(sim) > 1)
+      trace_printf(sim, "----A: New message arrives, send window is not full, send new messge to layer3!\n");
+    send_message(sim, s, message);
   }
-  /* if blocked,  window is full */
+  /* if blocked, wait in the send queue if it has room */
+  else if (msgq_put(sim, &s->queue, &message) == 0) {
+    if (TRACE_LEVEL(sim) > 1)
+      trace_printf(sim, "----A: New message arrives, send window is full, queue it\n");
+  }
+  /* window and queue are full */
   else {
-    if (TRACE > 0)
-      printf("----A: New message arrives, send window is full\n");
-    window_full++;
+    if (TRACE_LEVEL(sim) > 0)
+      trace_printf(sim, "----A: New message arrives, send window is full\n");
+    sim->stats.window_full++;
   }
 }
 
+/* send queued messages while the window has room */
+static void drain_queue(struct sim *sim, struct gbn_sender *s)
+{
+  struct msg message;
+
+  while (window_open(s) && msgq_get(sim, &s->queue, &message) == 0)
+    send_message(sim, s, message);
+}
+
 
 /* called from layer 3, when a packet arrives for layer 4
    In this practical this will always be an ACK as B never sends data.
 */
-void A_input(struct pkt packet)
+static void A_input(struct sim *sim, struct pkt packet)
 {
+  struct gbn_sender *s = sim->state[A];
   int ackcount = 0;
   int i;
 
   /* if received ACK is not corrupted */
   if (!IsCorrupted(packet)) {
-    if (TRACE > 0)
-      printf("----A: uncorrupted ACK %d is received\n",packet.acknum);
-    total_ACKs_received++;
+    if (TRACE_LEVEL(sim) > 0)
+      trace_printf(sim, "----A: uncorrupted ACK %d is received\n",packet.acknum);
+    sim->stats.total_ACKs_received++;
 
     /* check if new ACK or duplicate */
-    if (windowcount != 0) {
-          int seqfirst = buffer[windowfirst].seqnum;
-          int seqlast = buffer[windowlast].seqnum;
+    if (s->windowcount != 0) {
+          int seqfirst = s->buffer[s->windowfirst].seqnum;
+          int seqlast = s->buffer[s->windowlast].seqnum;
           /* check case when seqnum has and hasn't wrapped */
           if (((seqfirst <= seqlast) && (packet.acknum >= seqfirst && packet.acknum <= seqlast)) ||
               ((seqfirst > seqlast) && (packet.acknum >= seqfirst || packet.acknum <= seqlast))) {
 
             /* packet is a new ACK */
-            if (TRACE > 0)
-              printf("----A: ACK %d is not a duplicate\n",packet.acknum);
-            new_ACKs++;
+            if (TRACE_LEVEL(sim) > 0)
+              trace_printf(sim, "----A: ACK %d is not a duplicate\n",packet.acknum);
+            sim->stats.new_ACKs++;
+            s->dupcount = 0;
 
             /* cumulative acknowledgement - determine how many packets are ACKed */
             if (packet.acknum >= seqfirst)
               ackcount = packet.acknum + 1 - seqfirst;
             else
-              ackcount = SEQSPACE - seqfirst + packet.acknum;
+              ackcount = s->seqspace - seqfirst + packet.acknum;
+            cc_ack(sim, &s->cc, ackcount);
+
+            if (s->recovering && (s->recover - seqfirst + s->seqspace) % s->seqspace < ackcount)
+              s->recovering = false;
+
+            /* time the round trip of the packet ACKed, unless it was
+               resent and the ACK could be for either copy (Karn) */
+            i = (s->windowfirst + ackcount - 1) % s->windowsize;
+            if (!s->resent[i])
+              rto_sample(sim, &s->rto, sim->time - s->sendtime[i]);
 
 	    /* slide window by the number of packets ACKed */
-            windowfirst = (windowfirst + ackcount) % WINDOWSIZE;
+            s->windowfirst = (s->windowfirst + ackcount) % s->windowsize;
 
-            /* delete the acked packets from window buffer */
+            /* delete the acked packets from window buffer; B may have had
+               some that were waiting to be resent */
             for (i=0; i<ackcount; i++)
-              windowcount--;
+              s->windowcount--;
+            s->outstanding = ackcount < s->outstanding ? s->outstanding - ackcount : 0;
+
+	    /* start timer again if there are still more unacked packets in
+	       flight, and resend those the congestion window now has room for */
+            stoptimer(sim, A);
+            if (s->outstanding > 0)
+              start_timer(sim, s);
+            resend_more(sim, s);
 
-	    /* start timer again if there are still more unacked packets in window */
-            stoptimer(A);
-            if (windowcount > 0)
-              starttimer(A, RTT);
+            /* the window has moved on, so messages waiting can go */
+            drain_queue(sim, s);
 
           }
+          else if (s->dupthresh > 0)
+            duplicate_ack(sim, s, packet.acknum, seqfirst);
         }
         else
-          if (TRACE > 0)
-        printf ("----A: duplicate ACK received, do nothing!\n");
+          if (TRACE_LEVEL(sim) > 0)
+        trace_printf(sim, "----A: duplicate ACK received, do nothing!\n");
   }
   else
-    if (TRACE > 0)
-      printf ("----A: corrupted ACK is received, do nothing!\n");
+    if (TRACE_LEVEL(sim) > 0)
+      trace_printf(sim, "----A: corrupted ACK is received, do nothing!\n");
 }
 
 /* called when A's timer goes off */
-void A_timerinterrupt(void)
+static void A_timerinterrupt(struct sim *sim)
 {
-  int i;
-
-  if (TRACE > 0)
-    printf("----A: time out,resend packets!\n");
+  struct gbn_sender *s = sim->state[A];
 
-  for(i=0; i<windowcount; i++) {
+  if (TRACE_LEVEL(sim) > 0)
+    trace_printf(sim, "----A: time out,resend packets!\n");
+  rto_backoff(sim, &s->rto);
+  cc_timeout(sim, &s->cc, s->outstanding);
+  resend_window(sim, s);
+}
 
-    if (TRACE > 0)
-      printf ("---A: resending packet %d\n", (buffer[(windowfirst+i) % WINDOWSIZE]).seqnum);
 
-    tolayer3(A,buffer[(windowfirst+i) % WINDOWSIZE]);
-    packets_resent++;
-    if (i==0) starttimer(A,RTT);
-  }
-}
 
+/* after a loss, packets of the window may wait to be resent */
+static void A_snapshot(const struct sim *sim, struct protocol_snapshot *snap)
+{
+  const struct gbn_sender *s = sim->state[A];
 
+  snap->inflight = s->outstanding;
+  snap->occupied = s->windowcount;
+  snap->window = cc_window(&s->cc);
+  snap->queued = s->queue.count;
+}
 
 /* the following routine will be called once (only) before any other */
 /* entity A routines are called. You can use it to do any initialization */
-void A_init(void)
+static void A_init(struct sim *sim)
 {
+  struct gbn_sender *s;
+  int w = sim->params.window;
+
+  /* the window arrays follow the struct in one block, which sim_free()
+     frees as a whole */
+  s = malloc(sizeof(struct gbn_sender) + w * (sizeof(struct pkt) + sizeof(float) + sizeof(bool))
+             + msgq_size(sim->params.sendq));
+  if (s == NULL) {
+    printf("memory allocation for sender failed.");
+    exit(EXIT_FAILURE);
+  }
+  sim->state[A] = s;
+  s->windowsize = w;
+  s->seqspace = sim->params.seqspace;
+  s->buffer = (struct pkt *)(s + 1);
+  s->sendtime = (float *)(s->buffer + w);
+  msgq_init(&s->queue, s->sendtime + w, sim->params.sendq);
+  s->resent = (bool *)((char *)s->queue.since + msgq_size(sim->params.sendq));
+
   /* initialise A's window, buffer and sequence number */
-  A_nextseqnum = 0;  /* A starts with seq num 0, do not change this */
-  windowfirst = 0;
-  windowlast = -1;   /* windowlast is where the last packet sent is stored.
+  s->A_nextseqnum = 0;  /* A starts with seq num 0, do not change this */
+  s->windowfirst = 0;
+  s->windowlast = -1;   /* windowlast is where the last packet sent is stored.
 		     new packets are placed in winlast + 1
 		     so initially this is set to -1
 		   */
-  windowcount = 0;
+  s->windowcount = 0;
+  s->outstanding = 0;
+  rto_init(sim, &s->rto, sim->params.rtt);
+  cc_init(sim, &s->cc, w);
+  s->dupthresh = sim->params.dupacks;
+  s->dupcount = 0;
+  s->recovering = false;
 }
 
 
 
 /********* Receiver (B)  variables and procedures ************/
 
-static int expectedseqnum; /* the sequence number expected next by the receiver */
-static int B_nextseqnum;   /* the sequence number for the next packets sent by B */
-
-
-/* called from layer 3, when a packet arrives for layer 4 at B*/
-void B_input(struct pkt packet)
+struct gbn_receiver {
+  int windowsize;     /* the sender's window */
+  int seqspace;       /* sequence numbers run from 0 to seqspace - 1 */
+  int expectedseqnum; /* the sequence number expected next by the receiver */
+  int B_nextseqnum;   /* the sequence number for the next packets sent by B */
+  int ackevery;       /* in-order packets covered by one ACK */
+  float ackdelay;     /* longest an ACK is held back */
+  int ackpending;     /* in-order packets received since the last ACK */
+  bool gap;           /* a packet has been discarded for arriving ahead of
+                         the expected one, which has not arrived since */
+  float *firstseen;   /* by sequence number, when a packet was first
+                         discarded for arriving ahead of a gap, or -1 */
+};
+
+/* send the cumulative ACK for everything delivered so far, which also
+   covers any packets whose ACK was being held back */
+static void send_ack(struct sim *sim, struct gbn_receiver *r)
 {
   struct pkt sendpkt;
   int i;
 
-  /* if not corrupted and received packet is in order */
-  if  ( (!IsCorrupted(packet))  && (packet.seqnum == expectedseqnum) ) {
-    if (TRACE > 0)
-      printf("----B: packet %d is correctly received, send ACK!\n",packet.seqnum);
-    packets_received++;
-
-    /* deliver to receiving application */
-    tolayer5(B, packet.payload);
-
-    /* send an ACK for the received packet */
-    sendpkt.acknum = expectedseqnum;
+  if (r->ackpending > 0 && r->ackevery > 1)
+    stoptimer(sim, B);
+  r->ackpending = 0;
 
-    /* update state variables */
-    expectedseqnum = (expectedseqnum + 1) % SEQSPACE;
-  }
-  else {
-    /* packet is corrupted or out of order resend last ACK */
-    if (TRACE > 0)
-      printf("----B: packet corrupted or not expected sequence number, resend ACK!\n");
-    if (expectedseqnum == 0)
-      sendpkt.acknum = SEQSPACE - 1;
-    else
-      sendpkt.acknum = expectedseqnum - 1;
-  }
+  if (r->expectedseqnum == 0)
+    sendpkt.acknum = r->seqspace - 1;
+  else
+    sendpkt.acknum = r->expectedseqnum - 1;
 
   /* create packet */
-  sendpkt.seqnum = B_nextseqnum;
-  B_nextseqnum = (B_nextseqnum + 1) % 2;
+  sendpkt.seqnum = r->B_nextseqnum;
+  r->B_nextseqnum = (r->B_nextseqnum + 1) % 2;
 
   /* we don't have any data to send.  fill payload with 0's */
   for ( i=0; i<20 ; i++ )
@@ -249,15 +408,92 @@ void B_input(struct pkt packet)
   sendpkt.checksum = ComputeChecksum(sendpkt);
 
   /* send out packet */
-  tolayer3 (B, sendpkt);
+  tolayer3 (sim, B, sendpkt);
+}
+
+/* called from layer 3, when a packet arrives for layer 4 at B*/
+static void B_input(struct sim *sim, struct pkt packet)
+{
+  struct gbn_receiver *r = sim->state[B];
+
+  /* if not corrupted and received packet is in order */
+  if  ( (!IsCorrupted(packet))  && (packet.seqnum == r->expectedseqnum) ) {
+    if (TRACE_LEVEL(sim) > 0)
+      trace_printf(sim, "----B: packet %d is correctly received, send ACK!\n",packet.seqnum);
+    sim->stats.packets_received++;
+
+    /* deliver to receiving application; a packet that got here before
+       was held up behind the gap */
+    tolayer5(sim, B, packet.payload);
+    if (r->firstseen[packet.seqnum] >= 0.0) {
+      hist_add(&sim->hol, sim->time - r->firstseen[packet.seqnum]);
+      r->firstseen[packet.seqnum] = -1.0;
+    }
+
+    /* update state variables */
+    r->expectedseqnum = (r->expectedseqnum + 1) % r->seqspace;
+
+    /* with delayed ACKs, hold the ACK back until ackevery packets are
+       waiting for it or the timer goes off; but a packet that fills a gap
+       is ACKed at once, so the sender can recover without waiting */
+    if (r->gap)
+      r->gap = false;
+    else if (++r->ackpending < r->ackevery) {
+      if (r->ackpending == 1)
+        starttimer(sim, B, r->ackdelay);
+      return;
+    }
+  }
+  else {
+    /* a packet up to seqspace - windowsize behind the expected one can
+       only be a copy of one already delivered; further back it could also
+       be a packet ahead of the expected one, so it is not counted */
+    if (!IsCorrupted(packet)
+        && (r->expectedseqnum - packet.seqnum + r->seqspace) % r->seqspace
+           <= r->seqspace - r->windowsize)
+      sim->stats.spurious_resends++;
+    else if (!IsCorrupted(packet)) {
+      sim->stats.out_of_order++;    /* ahead of a gap, discarded */
+      r->gap = true;
+      if (r->firstseen[packet.seqnum] < 0.0)
+        r->firstseen[packet.seqnum] = sim->time;
+    }
+
+    /* packet is corrupted or out of order resend last ACK, at once so
+       that the sender hears of the gap */
+    if (TRACE_LEVEL(sim) > 0)
+      trace_printf(sim, "----B: packet corrupted or not expected sequence number, resend ACK!\n");
+  }
+
+  send_ack(sim, r);
 }
 
 /* the following routine will be called once (only) before any other */
 /* entity B routines are called. You can use it to do any initialization */
-void B_init(void)
+static void B_init(struct sim *sim)
 {
-  expectedseqnum = 0;
-  B_nextseqnum = 1;
+  struct gbn_receiver *r;
+  int i;
+
+  r = malloc(sizeof(struct gbn_receiver) + sim->params.seqspace * sizeof(float));
+  if (r == NULL) {
+    printf("memory allocation for receiver failed.");
+    exit(EXIT_FAILURE);
+  }
+  sim->state[B] = r;
+  r->windowsize = sim->params.window;
+  r->seqspace = sim->params.seqspace;
+  r->ackevery = sim->params.ackevery;
+  r->ackdelay = sim->params.ackdelay;
+
+  r->firstseen = (float *)(r + 1);
+
+  r->expectedseqnum = 0;
+  r->B_nextseqnum = 1;
+  r->ackpending = 0;
+  r->gap = false;
+  for (i = 0; i < r->seqspace; i++)
+    r->firstseen[i] = -1.0;
 }
 
 /******************************************************************************
@@ -265,11 +501,26 @@ void B_init(void)
  *****************************************************************************/
 
 /* Note that with simplex transfer from a-to-B, there is no B_output() */
-void B_output(struct msg message)
+static void B_output(struct sim *sim, struct msg message)
 {
 }
 
-/* called when B's timer goes off */
-void B_timerinterrupt(void)
+/* called when B's timer goes off: the delayed ACK is due */
+static void B_timerinterrupt(struct sim *sim)
 {
+  struct gbn_receiver *r = sim->state[B];
+
+  if (TRACE_LEVEL(sim) > 0)
+    trace_printf(sim, "----B: delayed ACK timer went off, send ACK!\n");
+  r->ackpending = 0;            /* the timer is no longer running */
+  send_ack(sim, r);
 }
+
+const struct protocol gbn_protocol = {
+  "gbn", BIDIRECTIONAL, min_seqspace,
+  A_init, B_init,
+  A_output, B_output,
+  A_input, B_input,
+  A_timerinterrupt, B_timerinterrupt,
+  A_snapshot
+};
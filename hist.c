@@ -0,0 +1,63 @@
+#include <math.h>
+#include <string.h>
+#include "hist.h"
+
+void hist_init(struct hist *h)
+{
+  memset(h, 0, sizeof(*h));
+}
+
+/* the bucket of a value of v ticks */
+static int bucket(uint64_t v)
+{
+  int shift;
+
+  if (v < HIST_SUB)
+    return (int)v;
+  shift = 63 - __builtin_clzll(v) - (HIST_SUB_BITS - 1);  /* v >> shift is in [SUB/2, SUB) */
+  if (shift > HIST_DOUBLINGS)
+    return HIST_BUCKETS - 1;
+  return HIST_SUB + (shift - 1) * (HIST_SUB / 2) + (int)(v >> shift) - HIST_SUB / 2;
+}
+
+/* the largest value in ticks that falls in bucket b */
+static uint64_t bucket_top(int b)
+{
+  int shift;
+
+  if (b < HIST_SUB)
+    return b;
+  shift = (b - HIST_SUB) / (HIST_SUB / 2) + 1;
+  return (((uint64_t)((b - HIST_SUB) % (HIST_SUB / 2) + HIST_SUB / 2) + 1) << shift) - 1;
+}
+
+void hist_add(struct hist *h, double value)
+{
+  if (value < 0.0)
+    value = 0.0;
+  h->counts[bucket((uint64_t)(value / HIST_TICK + 0.5))]++;
+  h->n++;
+  h->sum += value;
+  if (value > h->max)
+    h->max = value;
+}
+
+double hist_quantile(const struct hist *h, double q)
+{
+  uint64_t rank, seen = 0;
+  double v;
+  int b;
+
+  if (h->n == 0)
+    return 0.0;
+  rank = (uint64_t)ceil(q * h->n);
+  if (rank < 1)
+    rank = 1;
+  for (b = 0; b < HIST_BUCKETS; b++) {
+    seen += h->counts[b];
+    if (seen >= rank)
+      break;
+  }
+  v = bucket_top(b) * HIST_TICK;
+  return v < h->max ? v : h->max;
+}
@@ -0,0 +1,41 @@
+#ifndef HIST_H
+#define HIST_H
+
+/* A streaming histogram of non-negative times, after HdrHistogram.
+
+   Values are counted in ticks of HIST_TICK time units.  The first
+   HIST_SUB ticks each have a bucket of their own; after that every
+   doubling of the value is split into HIST_SUB/2 buckets, so a value
+   is known to within 1 part in HIST_SUB/2 whatever its size.  The
+   memory is fixed however many values are added, and a percentile is
+   found by walking the buckets. */
+
+#include <stdint.h>
+
+#define HIST_TICK     0.001     /* resolution of small values */
+#define HIST_SUB_BITS 8
+#define HIST_SUB      (1 << HIST_SUB_BITS)
+#define HIST_DOUBLINGS 40       /* values up to HIST_SUB << 40 ticks */
+#define HIST_BUCKETS  (HIST_SUB + HIST_DOUBLINGS * (HIST_SUB / 2))
+
+struct hist {
+  uint32_t counts[HIST_BUCKETS];
+  int n;                  /* values added */
+  double sum;
+  float max;
+};
+
+extern void hist_init(struct hist *h);
+
+extern void hist_add(struct hist *h, double value);
+
+/* the value that a fraction q of those added are at or below, to the
+   precision of the buckets; 0 if none have been added */
+extern double hist_quantile(const struct hist *h, double q);
+
+static inline double hist_mean(const struct hist *h)
+{
+  return h->n ? h->sum / h->n : 0.0;
+}
+
+#endif
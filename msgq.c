@@ -0,0 +1,48 @@
+#include "msgq.h"
+#include "sim.h"
+
+size_t msgq_size(int capacity)
+{
+  return capacity * (sizeof(struct msg) + sizeof(float));
+}
+
+void msgq_init(struct msgq *q, void *mem, int capacity)
+{
+  q->since = mem;
+  q->msgs = (struct msg *)(q->since + capacity);
+  q->capacity = capacity;
+  q->head = 0;
+  q->count = 0;
+}
+
+int msgq_put(struct sim *sim, struct msgq *q, const struct msg *m)
+{
+  int i;
+
+  if (q->count == q->capacity)
+    return -1;
+  i = (q->head + q->count++) % q->capacity;
+  q->msgs[i] = *m;
+  q->since[i] = sim->time;
+  sim->stats.queued++;
+  if (q->count > sim->stats.queue_peak)
+    sim->stats.queue_peak = q->count;
+  return 0;
+}
+
+int msgq_get(struct sim *sim, struct msgq *q, struct msg *m)
+{
+  float waited;
+
+  if (q->count == 0)
+    return -1;
+  *m = q->msgs[q->head];
+  waited = sim->time - q->since[q->head];
+  q->head = (q->head + 1) % q->capacity;
+  q->count--;
+  sim->stats.dequeued++;
+  sim->stats.queue_delay += waited;
+  if (waited > sim->stats.queue_delay_max)
+    sim->stats.queue_delay_max = waited;
+  return 0;
+}
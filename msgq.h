@@ -0,0 +1,37 @@
+#ifndef MSGQ_H
+#define MSGQ_H
+
+/* A bounded FIFO of messages from layer 5 waiting for room in the send
+   window.  The ring lives in memory supplied by the owner, msgq_size()
+   bytes of it, so a sender can keep it in the same block as the rest of
+   its state.  The time each message was queued is kept so the
+   simulation's statistics show how long messages waited. */
+
+#include <stddef.h>
+#include "emulator.h"
+
+struct msgq {
+  struct msg *msgs;
+  float *since;           /* when each message was queued */
+  int capacity;
+  int head;               /* oldest message */
+  int count;
+};
+
+/* bytes of memory a queue of capacity messages needs */
+extern size_t msgq_size(int capacity);
+
+extern void msgq_init(struct msgq *q, void *mem, int capacity);
+
+/* queue m; returns -1 if the queue is full */
+extern int msgq_put(struct sim *sim, struct msgq *q, const struct msg *m);
+
+/* take the oldest message into m; returns -1 if the queue is empty */
+extern int msgq_get(struct sim *sim, struct msgq *q, struct msg *m);
+
+static inline int msgq_empty(const struct msgq *q)
+{
+  return q->count == 0;
+}
+
+#endif
@@ -0,0 +1,396 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include "sim.h"
+
+/* Parameters can be given by name as well as through init()'s prompts.
+   The names below are shared by every front end that sets parameters
+   from text: command line flags, config files and sweep grids. */
+
+#define MAXLINE 1024
+
+static int parse_int(const char *value, int *out)
+{
+  char *end;
+  long v;
+
+  v = strtol(value, &end, 10);
+  if (end == value || *end != '\0')
+    return -1;
+  *out = (int)v;
+  return 0;
+}
+
+static int parse_float(const char *value, float *out)
+{
+  char *end;
+  double v;
+
+  v = strtod(value, &end);
+  if (end == value || *end != '\0')
+    return -1;
+  *out = (float)v;
+  return 0;
+}
+
+static int parse_unsigned(const char *value, unsigned int *out)
+{
+  char *end;
+  unsigned long v;
+
+  v = strtoul(value, &end, 10);
+  if (end == value || *end != '\0')
+    return -1;
+  *out = (unsigned int)v;
+  return 0;
+}
+
+/* set the link parameter key of l */
+static int set_link(struct link_params *l, const char *key, const char *value)
+{
+  if (strcmp(key, "bandwidth") == 0)
+    return parse_float(value, &l->bandwidth);
+  if (strcmp(key, "delay") == 0)
+    return parse_float(value, &l->delay);
+  if (strcmp(key, "queue") == 0)
+    return parse_int(value, &l->queue);
+  if (strcmp(key, "aqm") == 0) {
+    if (strcmp(value, "droptail") == 0)
+      l->aqm = LINK_DROPTAIL;
+    else if (strcmp(value, "red") == 0)
+      l->aqm = LINK_RED;
+    else
+      return -1;
+    return 0;
+  }
+  if (strcmp(key, "lossmodel") == 0) {
+    if (strcmp(value, "bernoulli") == 0)
+      l->lossmodel = LOSS_BERNOULLI;
+    else if (strcmp(value, "ge") == 0)
+      l->lossmodel = LOSS_GE;
+    else if (strcmp(value, "trace") == 0)
+      l->lossmodel = LOSS_TRACE;
+    else
+      return -1;
+    return 0;
+  }
+  if (strcmp(key, "ge_p") == 0)
+    return parse_float(value, &l->ge_p);
+  if (strcmp(key, "ge_r") == 0)
+    return parse_float(value, &l->ge_r);
+  if (strcmp(key, "ge_good") == 0)
+    return parse_float(value, &l->ge_good);
+  if (strcmp(key, "ge_bad") == 0)
+    return parse_float(value, &l->ge_bad);
+  if (strcmp(key, "losstrace") == 0) {
+    if (strlen(value) >= sizeof(l->losstrace))
+      return -1;
+    strcpy(l->losstrace, value);
+    return 0;
+  }
+  if (strcmp(key, "delaydist") == 0) {
+    if (strcmp(value, "uniform") == 0)
+      l->delaydist = DELAY_UNIFORM;
+    else if (strcmp(value, "exp") == 0)
+      l->delaydist = DELAY_EXP;
+    else if (strcmp(value, "pareto") == 0)
+      l->delaydist = DELAY_PARETO;
+    else if (strcmp(value, "empirical") == 0)
+      l->delaydist = DELAY_EMPIRICAL;
+    else
+      return -1;
+    return 0;
+  }
+  if (strcmp(key, "delaymin") == 0)
+    return parse_float(value, &l->delaymin);
+  if (strcmp(key, "delaymax") == 0)
+    return parse_float(value, &l->delaymax);
+  if (strcmp(key, "delaymean") == 0)
+    return parse_float(value, &l->delaymean);
+  if (strcmp(key, "delayshape") == 0)
+    return parse_float(value, &l->delayshape);
+  if (strcmp(key, "reorder") == 0)
+    return parse_float(value, &l->reorder);
+  if (strcmp(key, "reorderdepth") == 0)
+    return parse_int(value, &l->reorderdepth);
+  if (strcmp(key, "delayfile") == 0) {
+    if (strlen(value) >= sizeof(l->delayfile))
+      return -1;
+    strcpy(l->delayfile, value);
+    return 0;
+  }
+  return -1;
+}
+
+int sim_params_set(struct sim_params *p, const char *key, const char *value)
+{
+  /* link parameters are for the A->B link with an ab_ prefix, the B->A
+     one with ba_, and both without */
+  if (strncmp(key, "ab_", 3) == 0)
+    return set_link(&p->links[B], key + 3, value);
+  if (strncmp(key, "ba_", 3) == 0)
+    return set_link(&p->links[A], key + 3, value);
+  if (set_link(&p->links[B], key, value) == 0)
+    return set_link(&p->links[A], key, value);
+
+  if (strcmp(key, "messages") == 0)
+    return parse_int(value, &p->nsimmax);
+  if (strcmp(key, "loss") == 0)
+    return parse_float(value, &p->lossprob);
+  if (strcmp(key, "corrupt") == 0)
+    return parse_float(value, &p->corruptprob);
+  if (strcmp(key, "direction") == 0)
+    return parse_int(value, &p->corruptdirection);
+  if (strcmp(key, "lambda") == 0)
+    return parse_float(value, &p->lambda);
+  if (strcmp(key, "trace") == 0)
+    return parse_int(value, &p->trace);
+  if (strcmp(key, "seed") == 0)
+    return parse_unsigned(value, &p->seed);
+  if (strcmp(key, "protocol") == 0) {
+    if (strlen(value) >= sizeof(p->protocol))
+      return -1;
+    strcpy(p->protocol, value);
+    return 0;
+  }
+  if (strcmp(key, "tracefile") == 0) {
+    if (strlen(value) >= sizeof(p->tracefile))
+      return -1;
+    strcpy(p->tracefile, value);
+    return 0;
+  }
+  if (strcmp(key, "record") == 0) {
+    if (strlen(value) >= sizeof(p->recordfile))
+      return -1;
+    strcpy(p->recordfile, value);
+    return 0;
+  }
+  if (strcmp(key, "rng") == 0) {
+    if (strcmp(value, "xoshiro") == 0)
+      p->rng = RNG_XOSHIRO;
+    else if (strcmp(value, "legacy") == 0)
+      p->rng = RNG_LEGACY;
+    else
+      return -1;
+    return 0;
+  }
+  if (strcmp(key, "rto") == 0) {
+    if (strcmp(value, "fixed") == 0)
+      p->rto = RTO_FIXED;
+    else if (strcmp(value, "adaptive") == 0)
+      p->rto = RTO_ADAPTIVE;
+    else
+      return -1;
+    return 0;
+  }
+  if (strcmp(key, "window") == 0)
+    return parse_int(value, &p->window);
+  if (strcmp(key, "seqspace") == 0)
+    return parse_int(value, &p->seqspace);
+  if (strcmp(key, "rtt") == 0)
+    return parse_float(value, &p->rtt);
+  if (strcmp(key, "sack") == 0)
+    return parse_int(value, &p->sack);
+  if (strcmp(key, "sendq") == 0)
+    return parse_int(value, &p->sendq);
+  if (strcmp(key, "dupacks") == 0)
+    return parse_int(value, &p->dupacks);
+  if (strcmp(key, "samplelog") == 0) {
+    if (strlen(value) >= sizeof(p->samplelog))
+      return -1;
+    strcpy(p->samplelog, value);
+    return 0;
+  }
+  if (strcmp(key, "sampleinterval") == 0)
+    return parse_float(value, &p->sampleinterval);
+  if (strcmp(key, "sampleformat") == 0) {
+    if (strcmp(value, "csv") == 0)
+      p->sampleformat = SAMPLE_CSV;
+    else if (strcmp(value, "binary") == 0)
+      p->sampleformat = SAMPLE_BINARY;
+    else
+      return -1;
+    return 0;
+  }
+  if (strcmp(key, "ackevery") == 0)
+    return parse_int(value, &p->ackevery);
+  if (strcmp(key, "ackdelay") == 0)
+    return parse_float(value, &p->ackdelay);
+  if (strcmp(key, "cc") == 0) {
+    if (strlen(value) >= sizeof(p->cc))
+      return -1;
+    strcpy(p->cc, value);
+    return 0;
+  }
+  if (strcmp(key, "cwndlog") == 0) {
+    if (strlen(value) >= sizeof(p->cwndlog))
+      return -1;
+    strcpy(p->cwndlog, value);
+    return 0;
+  }
+  if (strcmp(key, "rtolog") == 0) {
+    if (strlen(value) >= sizeof(p->rtolog))
+      return -1;
+    strcpy(p->rtolog, value);
+    return 0;
+  }
+  return -1;
+}
+
+static char *trim(char *s)
+{
+  char *end;
+
+  while (isspace((unsigned char)*s))
+    s++;
+  end = s + strlen(s);
+  while (end > s && isspace((unsigned char)end[-1]))
+    *--end = '\0';
+  return s;
+}
+
+int sim_params_load(struct sim_params *p, const char *file)
+{
+  char line[MAXLINE];
+  char *s, *eq, *key, *value;
+  FILE *f;
+  int lineno = 0;
+
+  f = fopen(file, "r");
+  if (f == NULL) {
+    fprintf(stderr, "cannot open config file %s\n", file);
+    return -1;
+  }
+  while (fgets(line, sizeof(line), f) != NULL) {
+    lineno++;
+    if ((s = strchr(line, '#')) != NULL)
+      *s = '\0';
+    s = trim(line);
+    if (*s == '\0')
+      continue;
+    if ((eq = strchr(s, '=')) == NULL) {
+      fprintf(stderr, "%s:%d: expected key = value\n", file, lineno);
+      fclose(f);
+      return -1;
+    }
+    *eq = '\0';
+    key = trim(s);
+    value = trim(eq + 1);
+    if (sim_params_set(p, key, value) < 0) {
+      fprintf(stderr, "%s:%d: bad value for %s\n", file, lineno, key);
+      fclose(f);
+      return -1;
+    }
+  }
+  fclose(f);
+  return 0;
+}
+
+/* whether path can be opened for reading, so that a run which would fail
+   to load it is rejected with the other bad parameters */
+static int readable(const char *path)
+{
+  FILE *f = fopen(path, "r");
+
+  if (f == NULL)
+    return 0;
+  fclose(f);
+  return 1;
+}
+
+int sim_params_seqspace(const struct sim_params *p)
+{
+  const struct protocol *proto = protocol_find(p->protocol);
+  int i, margin = 0;
+
+  /* each of the reorderdepth packets or ACKs that may overtake an old one
+     can move the other side's window on by up to a whole window, and the
+     old one must still not look new when it arrives */
+  for (i = 0; i < 2; i++)
+    if (p->links[i].reorder > 0.0 && p->links[i].reorderdepth * p->window > margin)
+      margin = p->links[i].reorderdepth * p->window;
+  return proto->min_seqspace(p->window) + margin;
+}
+
+int sim_params_sack(const struct sim_params *p)
+{
+  return p->sack || p->ackevery > 1;
+}
+
+const char *sim_params_check(const struct sim_params *p)
+{
+  const struct protocol *proto;
+  int i;
+
+  if (p->nsimmax < 0)
+    return "messages must not be negative";
+  if (p->lossprob < 0.0 || p->lossprob > 1.0)
+    return "loss must be in [0,1]";
+  if (p->corruptprob < 0.0 || p->corruptprob > 1.0)
+    return "corrupt must be in [0,1]";
+  if (p->corruptdirection < 0 || p->corruptdirection > 2)
+    return "direction must be 0 (A->B), 1 (A<-B) or 2 (both)";
+  if (p->lambda <= 0.0)
+    return "lambda must be > 0";
+  if ((proto = protocol_find(p->protocol)) == NULL)
+    return "unknown protocol";
+  if (p->window < 1)
+    return "window must be at least 1";
+  if (p->seqspace != 0 && p->seqspace < proto->min_seqspace(p->window))
+    return "seqspace is too small for the window (gbn needs window+1, sr 2*window)";
+  if (p->rtt <= 0.0)
+    return "rtt must be > 0";
+  if (p->sack != 0 && p->sack != 1)
+    return "sack must be 0 or 1";
+  if (p->dupacks < 0)
+    return "dupacks must not be negative";
+  if (p->sendq < 0)
+    return "sendq must not be negative";
+  if (p->ackevery < 1)
+    return "ackevery must be at least 1";
+  if (p->ackdelay <= 0.0)
+    return "ackdelay must be > 0";
+  if (p->sampleinterval <= 0.0)
+    return "sampleinterval must be > 0";
+  if (cc_find(p->cc) == NULL)
+    return "unknown congestion control";
+  for (i = 0; i < 2; i++) {
+    if (p->links[i].bandwidth < 0.0)
+      return "bandwidth must not be negative";
+    if (p->links[i].delay < 0.0)
+      return "delay must not be negative";
+    if (p->links[i].queue < 0)
+      return "queue must not be negative";
+    if (p->links[i].bandwidth > 0.0 && p->links[i].aqm == LINK_RED && p->links[i].queue < 4)
+      return "aqm red needs a queue of at least 4";
+    if (p->links[i].ge_p < 0.0 || p->links[i].ge_p > 1.0
+        || p->links[i].ge_r < 0.0 || p->links[i].ge_r > 1.0
+        || p->links[i].ge_good < 0.0 || p->links[i].ge_good > 1.0
+        || p->links[i].ge_bad < 0.0 || p->links[i].ge_bad > 1.0)
+      return "ge_p, ge_r, ge_good and ge_bad must be in [0,1]";
+    if (p->links[i].lossmodel == LOSS_TRACE && p->links[i].losstrace[0] == '\0')
+      return "lossmodel trace needs a losstrace file";
+    if (p->links[i].lossmodel == LOSS_TRACE && !readable(p->links[i].losstrace))
+      return "losstrace cannot be opened";
+    if (p->links[i].delaymin < 0.0 || p->links[i].delaymax < p->links[i].delaymin)
+      return "delays must satisfy 0 <= delaymin <= delaymax";
+    if (p->links[i].delaymean < 0.0)
+      return "delaymean must not be negative";
+    if (p->links[i].delayshape <= 0.0)
+      return "delayshape must be > 0";
+    if (p->links[i].delaydist == DELAY_PARETO && p->links[i].delaymin <= 0.0)
+      return "delaydist pareto needs delaymin > 0";
+    if (p->links[i].delaydist == DELAY_EMPIRICAL && p->links[i].delayfile[0] == '\0')
+      return "delaydist empirical needs a delayfile";
+    if (p->links[i].delaydist == DELAY_EMPIRICAL && !readable(p->links[i].delayfile))
+      return "delayfile cannot be opened";
+    if (p->links[i].reorder < 0.0 || p->links[i].reorder > 1.0)
+      return "reorder must be in [0,1]";
+    if (p->links[i].reorderdepth < 1)
+      return "reorderdepth must be at least 1";
+  }
+  if (p->seqspace != 0 && p->seqspace < sim_params_seqspace(p))
+    return "seqspace is too small for the reordering (it needs reorderdepth*window more)";
+  return NULL;
+}
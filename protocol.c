@@ -0,0 +1,22 @@
+#include <string.h>
+#include "protocol.h"
+#include "gbn.h"
+#include "sr.h"
+
+const struct protocol *const protocols[] = {
+  &gbn_protocol,
+  &sr_protocol,
+  NULL
+};
+
+const struct protocol *protocol_find(const char *name)
+{
+  int i;
+
+  if (name[0] == '\0')
+    return protocols[0];
+  for (i = 0; protocols[i] != NULL; i++)
+    if (strcmp(protocols[i]->name, name) == 0)
+      return protocols[i];
+  return NULL;
+}
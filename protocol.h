@@ -0,0 +1,53 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+/* A transport protocol is the set of entry points the emulator calls for
+   the two entities, A and B.  Each protocol exports one struct protocol
+   and is listed in the table in protocol.c, so every protocol is linked
+   into the emulator and the one to run is picked by name. */
+
+#include "emulator.h"
+
+/* what a sender has outstanding at one moment, for the sampler */
+struct protocol_snapshot {
+  int inflight;           /* packets sent and not yet ACKed */
+  int occupied;           /* window slots they take up */
+  int window;             /* packets the window holds now */
+  int queued;             /* messages waiting for room in it */
+};
+
+struct protocol {
+  const char *name;       /* as given to the protocol parameter */
+  int bidirectional;      /* B also sends messages to A */
+
+  /* the smallest sequence number space that works with a window of
+     window packets; also used when none is given */
+  int (*min_seqspace)(int window);
+
+  /* called once, before any other entry point of the entity */
+  void (*A_init)(struct sim *);
+  void (*B_init)(struct sim *);
+
+  /* a message from layer 5 to send to the other side */
+  void (*A_output)(struct sim *, struct msg);
+  void (*B_output)(struct sim *, struct msg);
+
+  /* a packet from layer 3 */
+  void (*A_input)(struct sim *, struct pkt);
+  void (*B_input)(struct sim *, struct pkt);
+
+  /* the entity's timer went off */
+  void (*A_timerinterrupt)(struct sim *);
+  void (*B_timerinterrupt)(struct sim *);
+
+  /* describe what A has outstanding */
+  void (*A_snapshot)(const struct sim *, struct protocol_snapshot *);
+};
+
+/* every protocol, ending with NULL; the first is the default */
+extern const struct protocol *const protocols[];
+
+/* the protocol called name, the default if name is "", or NULL */
+extern const struct protocol *protocol_find(const char *name);
+
+#endif
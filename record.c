@@ -0,0 +1,111 @@
+#include <stdlib.h>
+#include <string.h>
+#include "record.h"
+
+#define RECORD_BUFSIZE (1 << 20)
+
+int record_create(struct recorder *r, const char *path)
+{
+  struct record_header h;
+
+  r->f = fopen(path, "wb");
+  if (r->f == NULL) {
+    fprintf(stderr, "cannot create record file %s\n", path);
+    return -1;
+  }
+  r->buf = malloc(RECORD_BUFSIZE);
+  if (r->buf != NULL)
+    setvbuf(r->f, r->buf, _IOFBF, RECORD_BUFSIZE);
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, RECORD_MAGIC, sizeof(h.magic));
+  h.version = RECORD_VERSION;
+  h.recsize = sizeof(struct record);
+  fwrite(&h, sizeof(h), 1, r->f);
+  return 0;
+}
+
+void record_put(struct recorder *r, const struct record *rec)
+{
+  fwrite(rec, sizeof(*rec), 1, r->f);
+}
+
+void record_close(struct recorder *r)
+{
+  fclose(r->f);
+  free(r->buf);
+  r->f = NULL;
+  r->buf = NULL;
+}
+
+FILE *record_open(const char *path)
+{
+  struct record_header h;
+  FILE *f;
+
+  f = fopen(path, "rb");
+  if (f == NULL) {
+    fprintf(stderr, "cannot open record file %s\n", path);
+    return NULL;
+  }
+  if (fread(&h, sizeof(h), 1, f) != 1
+      || memcmp(h.magic, RECORD_MAGIC, sizeof(h.magic)) != 0
+      || h.version != RECORD_VERSION || h.recsize != sizeof(struct record)) {
+    fprintf(stderr, "%s is not a version %d record file\n", path, RECORD_VERSION);
+    fclose(f);
+    return NULL;
+  }
+  return f;
+}
+
+int record_get(FILE *f, struct record *rec)
+{
+  return fread(rec, sizeof(*rec), 1, f) == 1;
+}
+
+int record_same(const struct record *a, const struct record *b)
+{
+  if (a->kind != b->kind || a->entity != b->entity || a->time != b->time)
+    return 0;
+  if (a->seqnum != b->seqnum || a->acknum != b->acknum || a->checksum != b->checksum
+      || memcmp(a->payload, b->payload, sizeof(a->payload)) != 0)
+    return 0;
+  if (a->kind == REC_START && a->value != b->value)
+    return 0;
+  if (a->fate != b->fate && a->fate != FATE_REPLAYED && b->fate != FATE_REPLAYED)
+    return 0;
+  return 1;
+}
+
+void record_print(FILE *out, long n, const struct record *rec)
+{
+  static const char *kinds[] = {
+    "timer", "layer5", "layer3", "send", "deliver", "start", "stop"
+  };
+  static const char *fates[] = { "ok", "lost", "corrupt-payload", "corrupt-seq", "corrupt-ack" };
+  int i;
+
+  fprintf(out, "%8ld  %12f  %c  %-7s", n, rec->time, rec->entity == A ? 'A' : 'B',
+          rec->kind < sizeof(kinds)/sizeof(kinds[0]) ? kinds[rec->kind] : "?");
+  switch (rec->kind) {
+  case REC_START:
+    fprintf(out, "  increment %f", rec->value);
+    break;
+  case REC_SEND:
+  case REC_LAYER3:
+  case REC_LAYER5:
+  case REC_DELIVER:
+    if (rec->kind != REC_LAYER5 && rec->kind != REC_DELIVER)
+      fprintf(out, "  seq %d ack %d check %d", rec->seqnum, rec->acknum, rec->checksum);
+    fprintf(out, "  ");
+    for (i = 0; i < 20; i++)
+      fputc(rec->payload[i] >= 32 && rec->payload[i] < 127 ? rec->payload[i] : '.', out);
+    if (rec->kind == REC_SEND || rec->kind == REC_LAYER3) {
+      if (rec->fate < sizeof(fates)/sizeof(fates[0]))
+        fprintf(out, "  %s", fates[rec->fate]);
+      else if (rec->fate == FATE_REPLAYED)
+        fprintf(out, "  replayed");
+    }
+    break;
+  }
+  fputc('\n', out);
+}
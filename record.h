@@ -0,0 +1,82 @@
+#ifndef RECORD_H
+#define RECORD_H
+
+/* Binary event records.
+
+   A record file starts with a struct record_header and is followed by
+   fixed-size struct records in host byte order, one for every event the
+   main loop dispatches and one for every call the protocol makes back
+   into the emulator.  A file can be replayed against a protocol with
+   sim_replay() and two files compared with the tracediff tool.
+
+   Dispatch records carry everything needed to re-drive the protocol: the
+   message handed to A_output(), or the packet (as delivered, after any
+   corruption) handed to A_input()/B_input(). */
+
+#include <stdio.h>
+#include <stdint.h>
+#include "emulator.h"
+
+#define RECORD_MAGIC   "NETREC\0\0"
+#define RECORD_VERSION 1
+
+/* record kinds; the dispatch kinds have the same codes as the event types */
+#define REC_TIMER   0   /* timer interrupt dispatched */
+#define REC_LAYER5  1   /* message from layer 5 given to the protocol */
+#define REC_LAYER3  2   /* packet from layer 3 given to the protocol */
+#define REC_SEND    3   /* protocol called tolayer3() */
+#define REC_DELIVER 4   /* protocol called tolayer5() */
+#define REC_START   5   /* protocol called starttimer() */
+#define REC_STOP    6   /* protocol called stoptimer() */
+
+/* what the medium did to a packet (REC_SEND and REC_LAYER3) */
+#define FATE_OK       0
+#define FATE_LOST     1
+#define FATE_PAYLOAD  2   /* payload corrupted */
+#define FATE_SEQNUM   3   /* seqnum corrupted */
+#define FATE_ACKNUM   4   /* acknum corrupted */
+#define FATE_REPLAYED 255 /* sent during a replay, the medium was not consulted */
+
+struct record_header {
+  char magic[8];
+  uint32_t version;
+  uint32_t recsize;       /* sizeof(struct record) of the writer */
+};
+
+struct record {
+  float time;             /* simulated time */
+  float value;            /* REC_START: timer increment; REC_SEND: arrival time */
+  uint8_t kind;
+  uint8_t entity;         /* A or B, where the event or call happened */
+  uint8_t fate;
+  uint8_t pad;
+  int32_t seqnum;         /* packet fields, zero if there is no packet */
+  int32_t acknum;
+  int32_t checksum;
+  char payload[20];       /* packet payload or message data */
+};
+
+struct recorder {
+  FILE *f;
+  char *buf;              /* stdio buffer for f */
+};
+
+/* create path and write its header; -1 if it cannot be created */
+extern int record_create(struct recorder *r, const char *path);
+extern void record_put(struct recorder *r, const struct record *rec);
+extern void record_close(struct recorder *r);
+
+/* open path and check its header; NULL (after a message) if it is not a
+   record file this build can read */
+extern FILE *record_open(const char *path);
+
+/* read the next record; 0 at end of file */
+extern int record_get(FILE *f, struct record *rec);
+
+/* true if a and b describe the same thing; a replayed send matches any fate */
+extern int record_same(const struct record *a, const struct record *b);
+
+/* one line describing record number n */
+extern void record_print(FILE *out, long n, const struct record *rec);
+
+#endif
@@ -0,0 +1,96 @@
+#include "rng.h"
+
+#define DEGREE     31   /* length of the legacy feedback register */
+#define SEPARATION 3    /* distance between its front and rear taps */
+#define LEGACY_MAX 2147483647.0   /* RAND_MAX of the legacy generator */
+
+static int legacy_next(struct rng *r)
+{
+  uint32_t val;
+
+  val = r->state[r->front] += r->state[r->rear];
+  if (++r->front == DEGREE)
+    r->front = 0;
+  if (++r->rear == DEGREE)
+    r->rear = 0;
+  return (int)(val >> 1);
+}
+
+static void legacy_seed(struct rng *r, unsigned int seed)
+{
+  int32_t word;
+  int32_t hi, lo;
+  int i;
+
+  if (seed == 0)
+    seed = 1;
+  word = (int32_t)seed;
+  r->state[0] = (uint32_t)word;
+  for (i = 1; i < DEGREE; i++) {
+    /* word = 16807 * word % 2147483647 without overflowing */
+    hi = word / 127773;
+    lo = word % 127773;
+    word = 16807 * lo - 2836 * hi;
+    if (word < 0)
+      word += 2147483647;
+    r->state[i] = (uint32_t)word;
+  }
+  r->front = SEPARATION;
+  r->rear = 0;
+  for (i = 0; i < 10 * DEGREE; i++)
+    legacy_next(r);
+}
+
+static inline uint64_t rotl(uint64_t x, int k)
+{
+  return (x << k) | (x >> (64 - k));
+}
+
+static uint64_t splitmix64(uint64_t *x)
+{
+  uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+void rng_seed(struct rng *r, int kind, unsigned int seed)
+{
+  uint64_t x = seed;
+  int i;
+
+  r->kind = kind;
+  if (kind == RNG_LEGACY)
+    legacy_seed(r, seed);
+  else
+    for (i = 0; i < 4; i++)
+      r->s[i] = splitmix64(&x);
+  r->pos = RNG_BATCH;         /* batch is empty */
+}
+
+void rng_fill(struct rng *r, double *out, int n)
+{
+  uint64_t s0, s1, s2, s3, t;
+  int i;
+
+  if (r->kind == RNG_LEGACY) {
+    for (i = 0; i < n; i++)
+      out[i] = legacy_next(r) / LEGACY_MAX;
+    return;
+  }
+
+  /* xoshiro256+, with the state kept in registers for the whole batch */
+  s0 = r->s[0]; s1 = r->s[1]; s2 = r->s[2]; s3 = r->s[3];
+  for (i = 0; i < n; i++) {
+    out[i] = ((s0 + s3) >> 11) * 0x1.0p-53;
+    t = s1 << 17;
+    s2 ^= s0;
+    s3 ^= s1;
+    s1 ^= s2;
+    s0 ^= s3;
+    s2 ^= t;
+    s3 = rotl(s3, 45);
+  }
+  r->s[0] = s0; r->s[1] = s1; r->s[2] = s2; r->s[3] = s3;
+}
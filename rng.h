@@ -0,0 +1,48 @@
+#ifndef RNG_H
+#define RNG_H
+
+/* Per-simulation random number generator.
+
+   Two generators are available:
+   - RNG_XOSHIRO, xoshiro256+, a fast 64-bit generator.
+   - RNG_LEGACY, which reproduces the sequence of the C library rand() on
+     glibc (the additive feedback generator behind random(3)).  A legacy
+     generator seeded with the old srand(9999) makes exactly the same
+     draws as the original emulator did.
+
+   Uniform draws are generated RNG_BATCH at a time into a buffer and
+   handed out one by one, so the per-draw cost is a load and a compare.
+   The stream is consumed in order, so batching never changes results. */
+
+#include <stdint.h>
+
+#define RNG_XOSHIRO 0
+#define RNG_LEGACY  1
+
+#define RNG_BATCH 64
+
+struct rng {
+  int kind;                   /* RNG_XOSHIRO or RNG_LEGACY */
+  uint64_t s[4];              /* xoshiro256+ state */
+  uint32_t state[31];         /* legacy rand() state */
+  int front, rear;
+  double batch[RNG_BATCH];    /* uniforms not yet handed out */
+  int pos;                    /* next unused entry of batch */
+};
+
+extern void rng_seed(struct rng *r, int kind, unsigned int seed);
+
+/* fill out with n uniform draws in [0,1] */
+extern void rng_fill(struct rng *r, double *out, int n);
+
+/* next uniform draw in [0,1] */
+static inline double rng_uniform(struct rng *r)
+{
+  if (r->pos == RNG_BATCH) {
+    rng_fill(r, r->batch, RNG_BATCH);
+    r->pos = 0;
+  }
+  return r->batch[r->pos++];
+}
+
+#endif
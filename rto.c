@@ -0,0 +1,61 @@
+#include <math.h>
+#include "rto.h"
+#include "sim.h"
+
+/* keep the run's timeout statistics and log the new timeout */
+static void changed(struct sim *sim, const struct rto *r, const char *why)
+{
+  struct sim_stats *st = &sim->stats;
+
+  if (r->timeout < st->rto_min)
+    st->rto_min = r->timeout;
+  if (r->timeout > st->rto_max)
+    st->rto_max = r->timeout;
+  st->rto_last = r->timeout;
+  if (sim->rtolog != NULL)
+    fprintf(sim->rtolog, "%f,%f,%f,%f,%s\n", sim->time, r->timeout, r->srtt,
+            r->rttvar, why);
+}
+
+void rto_init(struct sim *sim, struct rto *r, double initial)
+{
+  r->adaptive = sim->params.rto == RTO_ADAPTIVE;
+  r->srtt = 0.0;
+  r->rttvar = 0.0;
+  r->timeout = initial;
+  r->nsamples = 0;
+  sim->stats.rto_min = initial;
+  sim->stats.rto_max = initial;
+  changed(sim, r, "init");
+}
+
+void rto_sample(struct sim *sim, struct rto *r, double rtt)
+{
+  if (!r->adaptive)
+    return;
+  if (r->nsamples++ == 0) {
+    r->srtt = rtt;
+    r->rttvar = rtt / 2;
+  } else {
+    r->rttvar = 0.75 * r->rttvar + 0.25 * fabs(r->srtt - rtt);
+    r->srtt = 0.875 * r->srtt + 0.125 * rtt;
+  }
+  r->timeout = r->srtt + 4 * r->rttvar;
+  if (r->timeout < RTO_MIN)
+    r->timeout = RTO_MIN;
+  if (r->timeout > RTO_MAX)
+    r->timeout = RTO_MAX;
+  sim->stats.rto_samples++;
+  changed(sim, r, "sample");
+}
+
+void rto_backoff(struct sim *sim, struct rto *r)
+{
+  if (!r->adaptive)
+    return;
+  r->timeout *= 2;
+  if (r->timeout > RTO_MAX)
+    r->timeout = RTO_MAX;
+  sim->stats.rto_backoffs++;
+  changed(sim, r, "backoff");
+}
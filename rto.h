@@ -0,0 +1,46 @@
+#ifndef RTO_H
+#define RTO_H
+
+/* Retransmission timeout of a sender.
+
+   With RTO_FIXED the timeout is the constant the protocol starts with,
+   which is what the emulator's protocols have always used.
+
+   With RTO_ADAPTIVE the timeout follows the measured round trip time the
+   way TCP computes it (RFC 6298): a smoothed RTT and its mean deviation
+   are updated from each sample, and the timeout is SRTT + 4 * RTTVAR.
+   Following Karn's rule the protocol only samples packets that were
+   never retransmitted, and every timeout doubles the timeout until the
+   next sample arrives. */
+
+#define RTO_FIXED    0
+#define RTO_ADAPTIVE 1
+
+#define RTO_MIN   1.0     /* bounds of an adaptive timeout */
+#define RTO_MAX   1000.0
+
+struct sim;
+
+struct rto {
+  int adaptive;
+  double srtt;            /* smoothed round trip time */
+  double rttvar;          /* its mean deviation */
+  double timeout;         /* current retransmission timeout */
+  int nsamples;
+};
+
+/* start with the timeout initial, adaptive if the simulation asks for it */
+extern void rto_init(struct sim *sim, struct rto *r, double initial);
+
+/* a packet sent once was ACKed rtt after it was sent */
+extern void rto_sample(struct sim *sim, struct rto *r, double rtt);
+
+/* the timer went off */
+extern void rto_backoff(struct sim *sim, struct rto *r);
+
+static inline double rto_timeout(const struct rto *r)
+{
+  return r->timeout;
+}
+
+#endif
@@ -0,0 +1,95 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "sampler.h"
+#include "sim.h"
+
+void sampler_init(struct sampler *s, float interval)
+{
+  s->interval = interval;
+  s->next = 0.0;
+  s->samples = NULL;
+  s->n = 0;
+  s->cap = 0;
+}
+
+void sampler_free(struct sampler *s)
+{
+  free(s->samples);
+  s->samples = NULL;
+  s->n = 0;
+  s->cap = 0;
+}
+
+/* note the state of the run as it is at time */
+static void take(struct sim *sim, struct sampler *s, float time)
+{
+  struct protocol_snapshot snap;
+  struct sample *sp;
+  struct sample *grown;
+
+  if (s->n == s->cap) {
+    s->cap = s->cap ? 2 * s->cap : 1024;
+    grown = realloc(s->samples, s->cap * sizeof(struct sample));
+    if (grown == NULL) {
+      printf("memory allocation for samples failed.");
+      exit(EXIT_FAILURE);
+    }
+    s->samples = grown;
+  }
+  sim->proto->A_snapshot(sim, &snap);
+  sp = &s->samples[s->n++];
+  sp->time = time;
+  sp->delivered = sim->stats.messages_delivered;
+  sp->resent = sim->stats.packets_resent;
+  sp->inflight = snap.inflight;
+  sp->occupied = snap.occupied;
+  sp->window = snap.window;
+  sp->queued = snap.queued;
+}
+
+void sampler_until(struct sim *sim, float time)
+{
+  struct sampler *s = &sim->sampler;
+
+  /* nothing changes between events, so every sample due before the
+     next one sees the state the last event left */
+  while (s->next <= time) {
+    take(sim, s, s->next);
+    s->next = s->n * s->interval;     /* no rounding error builds up */
+  }
+}
+
+int sampler_write(const struct sampler *s, const char *path, int format)
+{
+  struct sample_header h;
+  const struct sample *sp;
+  FILE *f;
+  int i;
+
+  f = fopen(path, format == SAMPLE_BINARY ? "wb" : "w");
+  if (f == NULL) {
+    fprintf(stderr, "cannot create %s, the samples are not written\n", path);
+    return -1;
+  }
+  if (format == SAMPLE_BINARY) {
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, SAMPLE_MAGIC, sizeof(h.magic));
+    h.version = SAMPLE_VERSION;
+    h.recsize = sizeof(struct sample);
+    fwrite(&h, sizeof(h), 1, f);
+    fwrite(s->samples, sizeof(struct sample), s->n, f);
+  }
+  else {
+    fprintf(f, "time,messages_delivered,bytes_delivered,packets_resent,"
+            "inflight,occupied,window,queued\n");
+    for (i = 0; i < s->n; i++) {
+      sp = &s->samples[i];
+      fprintf(f, "%f,%d,%d,%d,%d,%d,%d,%d\n", sp->time, sp->delivered,
+              20 * sp->delivered, sp->resent, sp->inflight, sp->occupied,
+              sp->window, sp->queued);
+    }
+  }
+  fclose(f);
+  return 0;
+}
@@ -0,0 +1,57 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+/* Time series of a run.
+
+   Every interval time units the sampler notes how much has been
+   delivered and resent so far and what the sender has outstanding, the
+   latter from the protocol's A_snapshot().  The samples are kept in
+   memory and written out when the run ends, as CSV or as a binary file
+   of a struct sample_header followed by struct samples in host byte
+   order.  Counts are totals since the start of the run, so the
+   throughput over an interval is the difference of two samples; a
+   message is 20 bytes. */
+
+#include <stdint.h>
+
+#define SAMPLE_CSV    0
+#define SAMPLE_BINARY 1
+
+#define SAMPLE_MAGIC   "NETSMP\0\0"
+#define SAMPLE_VERSION 1
+
+struct sim;
+
+struct sample_header {
+  char magic[8];
+  uint32_t version;
+  uint32_t recsize;       /* sizeof(struct sample) of the writer */
+};
+
+struct sample {
+  float time;
+  int32_t delivered;      /* messages delivered to layer 5 at B */
+  int32_t resent;         /* packets resent by A */
+  int32_t inflight;       /* packets A has sent and not had ACKed */
+  int32_t occupied;       /* window slots those take up */
+  int32_t window;         /* packets the window holds now */
+  int32_t queued;         /* messages waiting for room in it */
+};
+
+struct sampler {
+  float interval;         /* 0 if the run is not sampled */
+  float next;             /* time of the next sample */
+  struct sample *samples;
+  int n, cap;
+};
+
+extern void sampler_init(struct sampler *s, float interval);
+extern void sampler_free(struct sampler *s);
+
+/* take the samples due before time, the time of the next event */
+extern void sampler_until(struct sim *sim, float time);
+
+/* write the samples to path; -1 after a message if it cannot be created */
+extern int sampler_write(const struct sampler *s, const char *path, int format);
+
+#endif
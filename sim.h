@@ -0,0 +1,209 @@
+#ifndef SIM_H
+#define SIM_H
+
+/* A simulator context.  Everything one simulation needs -- the event
+   queue, the channels, the random number generator, the parameters, the
+   statistics and the state of the protocol entities -- lives in a struct
+   sim, so any number of independent simulations can exist in one
+   process.  Nothing here is shared between contexts. */
+
+#include <stdio.h>
+#include "emulator.h"
+#include "eventq.h"
+#include "channel.h"
+#include "rng.h"
+#include "trace.h"
+#include "record.h"
+#include "rto.h"
+#include "protocol.h"
+#include "cc.h"
+#include "hist.h"
+#include "sampler.h"
+
+/* parameters of a run, normally read from the user by init() */
+struct sim_params {
+  int nsimmax;            /* number of msgs to generate, then stop */
+  float lossprob;         /* probability that a packet is dropped  */
+  float corruptprob;      /* probability that one bit is packet is flipped */
+  int corruptdirection;   /* A->B A<-B or bidirectional corruption/loss */
+  float lambda;           /* arrival rate of messages from layer 5 */
+  int trace;              /* TRACE level */
+  unsigned int seed;      /* seed of the random number generator */
+  int rng;                /* RNG_XOSHIRO or RNG_LEGACY */
+  char protocol[16];      /* protocol to run, "" for the default */
+  char tracefile[256];    /* where the trace goes, "" for stdout */
+  char recordfile[256];   /* binary event record to write, "" for none */
+  int rto;                /* RTO_FIXED or RTO_ADAPTIVE retransmission timeout */
+  char rtolog[256];       /* CSV log of every timeout change, "" for none */
+  int window;             /* sender window, in packets */
+  int seqspace;           /* number of sequence numbers, 0 for the least
+                             the protocol allows with the window and the
+                             channels, see sim_params_seqspace() */
+  float rtt;              /* retransmission timeout, the initial one if adaptive */
+  int sack;               /* SR ACKs carry selective acknowledgements, see
+                             sim_params_sack() */
+  int dupacks;            /* GBN fast retransmits after this many duplicate
+                             ACKs, 0 for never */
+  char cc[16];            /* congestion control algorithm, "" for none */
+  char cwndlog[256];      /* CSV log of every congestion window change, "" for none */
+  int sendq;              /* messages the sender queues while its window is
+                             full, 0 to drop them at once */
+  int ackevery;           /* B ACKs every this many in-order packets, 1 for each */
+  float ackdelay;         /* longest B holds back an ACK when ackevery > 1 */
+  char samplelog[256];    /* time series written at the end of the run, "" for none */
+  float sampleinterval;   /* time between its samples */
+  int sampleformat;       /* SAMPLE_CSV or SAMPLE_BINARY */
+  struct link_params links[2];  /* links[B] is A->B, links[A] is B->A, as
+                                   for channels */
+};
+
+struct sim_stats {
+  /* updated by the protocol */
+  int window_full;        /* count of the number of messages dropped due to full window (and queue) */
+  int total_ACKs_received;
+  int packets_resent;     /* count of the number of packets resent  */
+  int new_ACKs;           /* count of the number of acks correctly received */
+  int packets_received;   /* count of the packets received by receiver */
+  int spurious_resends;   /* packets received again after B had accepted them */
+  int sacked;             /* packets ACKed only by the SACK information of others */
+  int out_of_order;       /* packets B received ahead of one it is missing,
+                             which GBN discards and SR holds */
+  int held_peak;          /* most packets SR's B has held at once */
+  int fast_retransmits;   /* windows resent on duplicate ACKs */
+  double recovery_saved;  /* time left on the timer at those fast retransmits */
+
+  /* updated by the sender's struct msgq */
+  int queued;             /* messages that waited for room in the window */
+  int dequeued;           /* those that have left the queue */
+  int queue_peak;         /* most messages waiting at once */
+  double queue_delay;     /* total time waited by messages that left */
+  float queue_delay_max;
+
+  /* updated by the sender's struct rto */
+  int rto_samples;        /* round trip times measured */
+  int rto_backoffs;       /* timeouts doubled by a timer going off */
+  float rto_min, rto_max, rto_last;   /* range and final value of the timeout */
+
+  /* updated by the sender's struct cc */
+  int cc_losses;          /* losses found by duplicate ACKs */
+  int cc_timeouts;        /* losses found by the timer */
+  double cwnd_area;       /* integral of cwnd over time up to cwnd_since */
+  float cwnd_since;       /* when cwnd became cwnd_last */
+  float cwnd_last;
+
+  /* updated by emulator */
+  int messages_delivered;
+  int misdelivered;       /* of those, the ones B delivered that were not the
+                             next message A took from layer 5 */
+  int events;             /* events dispatched */
+  int ntolayer3;          /* number sent into layer 3 */
+  int ntolayer3_ab;       /* of those, the ones A sent to B */
+  int ntolayer3_ba;       /* and the ones B sent to A */
+  int nlost;              /* number lost in media */
+  int ncorrupt;           /* number corrupted by media*/
+};
+
+/* a message from layer 5 that A has taken */
+struct genmsg {
+  float time;             /* when it was generated */
+  char data;              /* the letter it is filled with */
+};
+
+struct sim {
+  struct sim_params params;
+  struct sim_stats stats;
+  const struct protocol *proto; /* the protocol being run */
+  int trace;              /* TRACE level, copied from params */
+  struct trace_sink tsink;      /* buffered trace output */
+
+  float time;             /* current simulated time */
+  int nsim;               /* number of messages from 5 to 4 so far */
+  struct eventq evlist;   /* the pending events, ordered by time */
+  struct event *timers[2];      /* pending TIMER_INTERRUPT of A and B, or NULL */
+  struct channel channels[2];   /* channels[B] is A->B, channels[A] is B->A */
+  struct rng rng;
+
+  struct recorder *rec;   /* binary event record, NULL if not recording */
+  int replaying;          /* events come from a record, see sim_replay() */
+  struct event replaytimer;     /* stands in for a running timer in a replay */
+  FILE *rtolog;           /* where timeout changes are logged, or NULL */
+  FILE *cwndlog;          /* where congestion window changes are logged, or NULL */
+
+  struct genmsg *gen;     /* the messages A has taken and B has not yet
+                             delivered, oldest at genhead */
+  int gencap, genhead, gencount;
+  struct hist latency;    /* layer 5 to layer 5 time of each message B delivers */
+  struct hist hol;        /* time a message held at B waited for the ones
+                             before it, updated by the protocol */
+  struct sampler sampler; /* the time series, if samplelog is set */
+
+  void *state[2];         /* protocol state of A and B, malloc'd by A_init()
+                             and B_init() and freed by sim_free() */
+};
+
+/* fill p with the defaults used when a value is not supplied */
+extern void sim_params_default(struct sim_params *p);
+
+/* set the parameter called key (messages, loss, corrupt, direction,
+   lambda, trace, tracefile, record, seed, rng, protocol, rto, rtolog,
+   window, seqspace, rtt, sack, dupacks, cc, cwndlog, sendq, ackevery,
+   ackdelay, samplelog, sampleinterval, sampleformat, or the channel's
+   bandwidth, delay, queue, aqm, lossmodel, ge_p, ge_r, ge_good, ge_bad,
+   losstrace, delaydist, delaymin, delaymax, delaymean, delayshape,
+   delayfile, reorder and reorderdepth, prefixed ab_ or ba_ for one
+   direction only) from its text value; returns -1 if the key is unknown
+   or the value does not parse */
+extern int sim_params_set(struct sim_params *p, const char *key, const char *value);
+
+/* set parameters from a config file of "key = value" lines, '#' starting
+   a comment; returns -1 after printing the offending line */
+extern int sim_params_load(struct sim_params *p, const char *file);
+
+/* the least seqspace the protocol can run with under p: enough for its
+   window, and for packets and ACKs overtaken by up to reorderdepth later
+   ones */
+extern int sim_params_seqspace(const struct sim_params *p);
+
+/* whether SR's ACKs carry SACK information under p: when asked for, and
+   always with delayed ACKs, as one ACK then stands for several packets */
+extern int sim_params_sack(const struct sim_params *p);
+
+/* NULL if p describes a valid run, otherwise what is wrong with it */
+extern const char *sim_params_check(const struct sim_params *p);
+
+/* create a simulation ready to run, with the protocol entities initialised;
+   NULL after a message if a file the channels need cannot be read */
+extern struct sim *sim_create(const struct sim_params *p);
+
+/* run events until none are left */
+extern void sim_run(struct sim *sim);
+
+/* instead of running, re-drive the protocol with the events dispatched in
+   the record file path, with the same protocol parameters as the run that
+   wrote it.  The protocol's calls into the emulator are recorded again but
+   have no effect, so comparing the new record with the old one shows
+   where the protocol now behaves differently.  Returns -1 if path cannot
+   be read. */
+extern int sim_replay(struct sim *sim, const char *path);
+
+/* print the end of run statistics */
+extern void sim_report(const struct sim *sim, FILE *out);
+
+/* one line of comma separated parameters and statistics per run, and the
+   header naming its columns */
+extern void sim_write_header(FILE *out);
+extern void sim_write_row(const struct sim *sim, FILE *out);
+
+extern void sim_free(struct sim *sim);
+
+/****************************************************************************/
+/* jimsrand(): return a double in range [0,1].  The routine below is used to */
+/* isolate all random number generation in one location.  Each simulation   */
+/* has its own generator, see rng.h                                         */
+/****************************************************************************/
+static inline double jimsrand(struct sim *sim)
+{
+  return rng_uniform(&sim->rng);
+}
+
+#endif
@@ -1,20 +1,28 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <string.h>
 #include "emulator.h"
 #include "sr.h"
+#include "sim.h"
+#include "msgq.h"
+#include "bitset.h"
 
 /* Selective Repeat Implementation based on gbn.c */
 
-#define RTT  16.0       /* round trip time.  MUST BE SET TO 16.0 when submitting assignment */
-#define WINDOWSIZE 6    /* the maximum number of buffered unacked packet
-                          MUST BE SET TO 6 when submitting assignment */
-
-#define SEQSPACE 12     /* SEQSPACE must be >= 2 * WINDOWSIZE */
-
 #define NOTINUSE (-1)   /* used to fill header fields that are not being used */
-
-int ComputeChecksum(struct pkt packet)
+#define BIDIRECTIONAL 0 /* 0 = A->B  1 = A<->B */
+
+/* With the sack parameter set, B fills the payload of each ACK with its
+   receive base, all packets before which it has delivered, followed by a
+   bitmap of the SACK_BITS packets after the base, a bit set for each one
+   it holds.  A then learns about every packet B has from any ACK that
+   gets through.  Delayed ACKs (ackevery > 1) always carry it, see
+   sim_params_sack(). */
+#define SACK_BITS 128
+#define SACK_WORDS (SACK_BITS / 64)
+
+static int ComputeChecksum(struct pkt packet)
 {
   int checksum = 0;
   int i;
@@ -27,7 +35,7 @@ int ComputeChecksum(struct pkt packet)
   return checksum;
 }
 
-bool IsCorrupted(struct pkt packet)
+static bool IsCorrupted(struct pkt packet)
 {
   if (packet.checksum == ComputeChecksum(packet))
     return (false);
@@ -36,47 +44,157 @@ bool IsCorrupted(struct pkt packet)
 }
 
 
-/********* Sender (A) variables and functions ************/
+/* a packet resent from the oldest end of the sender's window must not be
+   mistaken for one from the newest end of the receiver's */
+static int min_seqspace(int window)
+{
+  return 2 * window;
+}
 
-static struct pkt A_buffer[SEQSPACE];  /* array for storing packets waiting for ACK */
-static bool A_ackeds[SEQSPACE];        /* array for storing whether a packet has been ACKed */
+/********* Sender (A) variables and functions ************/
 
-static int A_nextseqnum = 0;           /* the next sequence number to be used by the sender */
-static int A_base = 0;                 /* the base of the window */
-static int unacked_packets = 0;
+struct sr_sender {
+  int windowsize;                 /* the maximum number of buffered unacked packets */
+  int seqspace;                   /* sequence numbers run from 0 to seqspace - 1 */
+
+  /* the arrays below have an entry per sequence number */
+  struct pkt *A_buffer;           /* array for storing packets waiting for ACK */
+  uint64_t *A_ackeds;             /* bitset of the packets that have been ACKed */
+
+  int A_nextseqnum;               /* the next sequence number to be used by the sender */
+  int A_base;                     /* the base of the window */
+  int unacked_packets;
+
+  /* Each outstanding packet has its own logical timer.  The timers are
+     kept in a list ordered by deadline, linked through tnext/tprev by
+     sequence number, and the emulator's single timer is run for the
+     earliest of them. */
+  float *deadline;                /* when the packet with that seqnum times out */
+  float *armed;                   /* the timeout its timer was started with */
+  int *tnext;                     /* next later deadline, or NOTINUSE */
+  int *tprev;                     /* next earlier deadline, or NOTINUSE */
+  int thead;                      /* earliest deadline, NOTINUSE if none */
+  int ttail;                      /* latest deadline */
+  bool timer_running;             /* the emulator timer is started ... */
+  float timer_expiry;             /* ... and goes off at this time */
+
+  float *sendtime;                /* when each packet was first sent */
+  uint64_t *resent;               /* bitset of those sent again since */
+  struct rto rto;                 /* the retransmission timeout */
+  struct cc cc;                   /* congestion control, limits new packets */
+  struct msgq queue;              /* messages waiting for room in the window */
+  bool sack;                      /* ACKs carry SACK information */
+};
+
+/* start the logical timer of seq, to go off a timeout after now */
+static void timer_add(struct sr_sender *s, int seq, float now)
+{
+  float when = now + rto_timeout(&s->rto);
+  int after = s->ttail;
+
+  /* deadlines are nearly always added in order, so search from the end */
+  while (after != NOTINUSE && s->deadline[after] > when)
+    after = s->tprev[after];
+
+  s->deadline[seq] = when;
+  s->armed[seq] = rto_timeout(&s->rto);
+  s->tprev[seq] = after;
+  if (after == NOTINUSE) {
+    s->tnext[seq] = s->thead;
+    s->thead = seq;
+  } else {
+    s->tnext[seq] = s->tnext[after];
+    s->tnext[after] = seq;
+  }
+  if (s->tnext[seq] == NOTINUSE)
+    s->ttail = seq;
+  else
+    s->tprev[s->tnext[seq]] = seq;
+}
 
-/* called from layer 5 (application layer), passed the message to be sent to other side */
-void A_output(struct msg message)
+/* stop the logical timer of seq */
+static void timer_remove(struct sr_sender *s, int seq)
 {
-  struct pkt p;
-  int i;
-  /* calculate current window size: how many unACKed packets are in-flight.
-  use modulo to handle sequence number wrap-around correctly. */
-  int window_size = (A_nextseqnum + SEQSPACE - A_base) % SEQSPACE;
+  if (s->tprev[seq] == NOTINUSE)
+    s->thead = s->tnext[seq];
+  else
+    s->tnext[s->tprev[seq]] = s->tnext[seq];
+  if (s->tnext[seq] == NOTINUSE)
+    s->ttail = s->tprev[seq];
+  else
+    s->tprev[s->tnext[seq]] = s->tprev[seq];
+}
 
-  /* debug print to check if variables get updated properly */
-  if (TRACE == 1) {
-    printf("A_output: window_size = %d, A_base = %d, A_nextseq = %d\n",
-      window_size, A_base, A_nextseqnum);
+/* make the emulator's timer go off at the earliest logical deadline,
+   leaving it alone if it already does */
+static void timer_rearm(struct sim *sim, struct sr_sender *s)
+{
+  if (s->timer_running) {
+    if (s->thead != NOTINUSE && s->deadline[s->thead] == s->timer_expiry)
+      return;
+    stoptimer(sim, A);
+    s->timer_running = false;
+  }
+  if (s->thead != NOTINUSE) {
+    s->timer_expiry = s->deadline[s->thead];
+    starttimer(sim, A, (double)s->timer_expiry - sim->time);
+    s->timer_running = true;
   }
+}
 
-  if (window_size >= WINDOWSIZE) {
-    /* If the window is full, drop the message (i.e., don't send it). */
-    if (TRACE > 0) {
-      printf("----A: New message arrives, send window is full\n");
-    }
+/* true if seq is in the sender's window, i.e. sent and not yet slid past */
+static bool in_send_window(const struct sr_sender *s, int seq)
+{
+  return (seq - s->A_base + s->seqspace) % s->seqspace
+    < (s->A_nextseqnum - s->A_base + s->seqspace) % s->seqspace;
+}
 
-    /* update global counter for dropped messages because of full window */
-    window_full++;
+/* seq is known to have reached B through the SACK information of an ACK */
+static void sack_one(struct sim *sim, struct sr_sender *s, int seq)
+{
+  if (bitset_test(s->A_ackeds, seq))
     return;
-  }
+  bitset_set(s->A_ackeds, seq);
+  s->unacked_packets--;
+  timer_remove(s, seq);
+  sim->stats.sacked++;
+}
 
-  if (TRACE > 1) {
-    printf("----A: New message arrives, send window is not full, send new messge to layer 3!\n");
-  }
+/* mark everything the SACK payload of an ACK reports as received */
+static void sack_input(struct sim *sim, struct sr_sender *s, const struct pkt *packet)
+{
+  int32_t base;
+  uint64_t map[SACK_WORDS], bits;
+  int seq, w;
+
+  memcpy(&base, packet->payload, sizeof(base));
+  memcpy(map, packet->payload + sizeof(base), sizeof(map));
+  if (base < 0 || base >= s->seqspace)
+    return;
+
+  /* B has every packet before its base; the base of an older ACK can be
+     behind A_base, and then says nothing new */
+  if ((base - s->A_base + s->seqspace) % s->seqspace
+      <= (s->A_nextseqnum - s->A_base + s->seqspace) % s->seqspace)
+    for (seq = s->A_base; seq != base; seq = (seq + 1) % s->seqspace)
+      sack_one(sim, s, seq);
+
+  for (w = 0; w < SACK_WORDS; w++)
+    for (bits = map[w]; bits != 0; bits &= bits - 1) {
+      seq = (base + 1 + 64 * w + __builtin_ctzll(bits)) % s->seqspace;
+      if (in_send_window(s, seq))
+        sack_one(sim, s, seq);
+    }
+}
+
+/* send message in a new packet; the window must have room for it */
+static void send_message(struct sim *sim, struct sr_sender *s, struct msg message)
+{
+  struct pkt p;
+  int i;
 
   /* construct packet to send */
-  p.seqnum = A_nextseqnum; /* assign sequence number */
+  p.seqnum = s->A_nextseqnum; /* assign sequence number */
   p.acknum = NOTINUSE; /* this is a packet, not an ACK */
 
   /* copy 20 byte payload from the message into the packet */
@@ -86,167 +204,390 @@ void A_output(struct msg message)
   p.checksum = ComputeChecksum(p); /* compute checksum to detect corruption later */
 
   /* save the packet in the sender's buffer so it can be retransmitted if needed */
-  A_buffer[A_nextseqnum] = p;
+  s->A_buffer[s->A_nextseqnum] = p;
 
   /* packet not acknowledged yet */
-  A_ackeds[A_nextseqnum] = false;
+  bitset_clear(s->A_ackeds, s->A_nextseqnum);
 
 
   /* send packet to simulator */
-  if (TRACE > 0) {
-    printf("Sending packet %d to layer 3\n", p.seqnum);
+  if (TRACE_LEVEL(sim) > 0) {
+    trace_printf(sim, "Sending packet %d to layer 3\n", p.seqnum);
   }
-  tolayer3(A, p);
+  tolayer3(sim, A, p);
 
-  /* if this is the first packet, start the tick timer. */
-  if (A_base == A_nextseqnum) {
-    starttimer(A, RTT);
-  }
+  s->sendtime[s->A_nextseqnum] = sim->time;
+  bitset_clear(s->resent, s->A_nextseqnum);
+
+  /* start the packet's own timer */
+  timer_add(s, s->A_nextseqnum, sim->time);
+  timer_rearm(sim, s);
 
   /* get next sequence number, wrap back to 0 */
-  A_nextseqnum = (A_nextseqnum + 1) % SEQSPACE;
-  unacked_packets++;
+  s->A_nextseqnum = (s->A_nextseqnum + 1) % s->seqspace;
+  s->unacked_packets++;
+}
+
+/* send queued messages while the window has room */
+static void drain_queue(struct sim *sim, struct sr_sender *s)
+{
+  struct msg message;
+
+  while ((s->A_nextseqnum + s->seqspace - s->A_base) % s->seqspace < cc_window(&s->cc)
+         && msgq_get(sim, &s->queue, &message) == 0)
+    send_message(sim, s, message);
+}
+
+/* called from layer 5 (application layer), passed the message to be sent to other side */
+static void A_output(struct sim *sim, struct msg message)
+{
+  struct sr_sender *s = sim->state[A];
+  /* calculate current window size: how many unACKed packets are in-flight.
+  use modulo to handle sequence number wrap-around correctly. */
+  int window_size = (s->A_nextseqnum + s->seqspace - s->A_base) % s->seqspace;
+
+  /* debug print to check if variables get updated properly */
+  if (TRACE_LEVEL(sim) == 1) {
+    trace_printf(sim, "A_output: window_size = %d, A_base = %d, A_nextseq = %d\n",
+      window_size, s->A_base, s->A_nextseqnum);
+  }
+
+  /* the congestion window is never more than windowsize; messages already
+  waiting in the queue go first */
+  if (window_size >= cc_window(&s->cc) || !msgq_empty(&s->queue)) {
+    /* If the window is full, queue the message, or if the queue is full
+    too, drop it (i.e., don't send it). */
+    if (msgq_put(sim, &s->queue, &message) == 0) {
+      if (TRACE_LEVEL(sim) > 1) {
+        trace_printf(sim, "----A: New message arrives, send window is full, queue it\n");
+      }
+      return;
+    }
+    if (TRACE_LEVEL(sim) > 0) {
+      trace_printf(sim, "----A: New message arrives, send window is full\n");
+    }
+
+    /* update counter for dropped messages because of full window */
+    sim->stats.window_full++;
+    return;
+  }
+
+  if (TRACE_LEVEL(sim) > 1) {
+    trace_printf(sim, "----A: New message arrives, send window is not full, send new messge to layer 3!\n");
+  }
+  send_message(sim, s, message);
 }
 
 
 /* called from layer 3, when a packet arrives for layer 4
    In this practical this will always be an ACK as B never sends data.
 */
-void A_input(struct pkt packet)
+static void A_input(struct sim *sim, struct pkt packet)
 {
+  struct sr_sender *s = sim->state[A];
   int acknum;
+  int unacked = s->unacked_packets;
   /* check if packet is corrupted */
   if (IsCorrupted(packet)) {
-    if (TRACE > 0)
-      printf("----A: corrupted ACK is received, do nothing!\n");
+    if (TRACE_LEVEL(sim) > 0)
+      trace_printf(sim, "----A: corrupted ACK is received, do nothing!\n");
     return;
   }
 
   acknum = packet.acknum;
 
   /* check if the ACK is out of range */
-  if (acknum < 0 || acknum >= SEQSPACE) {
-    if (TRACE == 0)
-      printf("----A: ACK %d is out of range, do nothing!\n", acknum);
+  if (acknum < 0 || acknum >= s->seqspace) {
+    if (TRACE_LEVEL(sim) == 0)
+      trace_printf(sim, "----A: ACK %d is out of range, do nothing!\n", acknum);
     return;
   }
 
-  if (TRACE > 0) {
-    printf("----A: uncorrupted ACK %d is received\n", acknum);
+  if (TRACE_LEVEL(sim) > 0) {
+    trace_printf(sim, "----A: uncorrupted ACK %d is received\n", acknum);
   }
 
-  total_ACKs_received++;
+  sim->stats.total_ACKs_received++;
 
   /* we need to only handle the ACKs for packets that are currently in the sender's window 
   if packet is already acknowledge, then is a duplicate ACK */
-  if (!A_ackeds[acknum]) {
-    A_ackeds[acknum] = true;
-    new_ACKs++;
-    unacked_packets--;
-
-    if (TRACE > 0) {
-      printf("----A: ACK %d is not a duplicate\n", acknum);
+  if (in_send_window(s, acknum) && !bitset_test(s->A_ackeds, acknum)) {
+    bitset_set(s->A_ackeds, acknum);
+    sim->stats.new_ACKs++;
+    s->unacked_packets--;
+    timer_remove(s, acknum);
+
+    /* time the round trip, unless the packet was resent and the ACK
+       could be for either copy (Karn) */
+    if (!bitset_test(s->resent, acknum))
+      rto_sample(sim, &s->rto, sim->time - s->sendtime[acknum]);
+
+    if (TRACE_LEVEL(sim) > 0) {
+      trace_printf(sim, "----A: ACK %d is not a duplicate\n", acknum);
     }
   } else {
-    if (TRACE > 0) {
-      printf("----A: duplicate ACK received, do nothing!\n");
+    if (TRACE_LEVEL(sim) > 0) {
+      trace_printf(sim, "----A: duplicate ACK received, do nothing!\n");
     }
   }
 
+  /* even a duplicate can report other packets B has received */
+  if (s->sack)
+    sack_input(sim, s, &packet);
+
   /* in selective repeat, the sender window base moves forward only if the base packet (A_base) has been acknowledged
   because the window is circular (going back to 0), we must use modulo to handle then wrap cleanly
-  we continue sliding the base forward until we find the first unACKed packet */
-  while (A_ackeds[A_base]) {
-      A_ackeds[A_base] = false;          /* reset slot for reuse */
-      A_base = (A_base + 1) % SEQSPACE;  /* slide the base forward, the modulo ensures that it wraps back to 0 */
-  }
+  we continue sliding the base forward until we find the first unACKed packet,
+  clearing the ACKed bits on the way so the slots can be reused */
+  s->A_base = (s->A_base + bitset_take_run(s->A_ackeds, s->seqspace, s->A_base)) % s->seqspace;
 
-  stoptimer(A);
-  if (unacked_packets > 0) {
-    starttimer(A, RTT);
-  }
+  if (s->unacked_packets < unacked)
+    cc_ack(sim, &s->cc, unacked - s->unacked_packets);
+
+  /* the window may have moved on, so messages waiting can go */
+  drain_queue(sim, s);
+
+  /* the earliest deadline may have been the packet just ACKed */
+  timer_rearm(sim, s);
 }
 
-void A_timerinterrupt(void)
+/* called when the earliest logical timer goes off: resend every packet
+   whose own timer has expired, and only those */
+static void A_timerinterrupt(struct sim *sim)
 {
-  if (TRACE > 0) {
-    printf("----A: time out,resend packets!\n");
-    printf("---A: resending packet %d\n", A_buffer[A_base].seqnum);
+  struct sr_sender *s = sim->state[A];
+  int seq;
+
+  s->timer_running = false;
+  if (TRACE_LEVEL(sim) > 0)
+    trace_printf(sim, "----A: time out,resend packets!\n");
+  /* packets sent close together time out one after another; the timeout
+     is doubled for the first, and again only for a packet whose timer was
+     started with the doubled one, so the doubling was not enough */
+  if (s->armed[s->thead] >= (float)rto_timeout(&s->rto))
+    rto_backoff(sim, &s->rto);
+  cc_timeout(sim, &s->cc, s->unacked_packets);
+
+  while ((seq = s->thead) != NOTINUSE && s->deadline[seq] <= sim->time) {
+    if (TRACE_LEVEL(sim) > 0)
+      trace_printf(sim, "---A: resending packet %d\n", seq);
+
+    tolayer3(sim, A, s->A_buffer[seq]); /* resend the packet */
+    sim->stats.packets_resent++; /* update counter for resent packets */
+    bitset_set(s->resent, seq);
+
+    timer_remove(s, seq);
+    timer_add(s, seq, sim->time); /* restart its timer */
   }
 
-  tolayer3(A, A_buffer[A_base]); /* resend the packet */
-  packets_resent++; /* update global counter for resent packets */
+  timer_rearm(sim, s);
+}
 
-  starttimer(A, RTT); /* restart the timer */
+/* packets ACKed out of order leave the window only when the base passes
+   them, so the window can be fuller than what is in flight */
+static void A_snapshot(const struct sim *sim, struct protocol_snapshot *snap)
+{
+  const struct sr_sender *s = sim->state[A];
+
+  snap->inflight = s->unacked_packets;
+  snap->occupied = (s->A_nextseqnum - s->A_base + s->seqspace) % s->seqspace;
+  snap->window = cc_window(&s->cc);
+  snap->queued = s->queue.count;
 }
 
-void A_init(void)
+static void A_init(struct sim *sim)
 {
-  int i;
+  struct sr_sender *s;
+  int n = sim->params.seqspace;
+  int words = BITSET_WORDS(n);
+
+  /* the per sequence number arrays follow the struct in one block, which
+     sim_free() frees as a whole */
+  s = malloc(sizeof(struct sr_sender) + 2 * words * sizeof(uint64_t)
+             + n * (sizeof(struct pkt) + 3 * sizeof(float) + 2 * sizeof(int))
+             + msgq_size(sim->params.sendq));
+  if (s == NULL) {
+    printf("memory allocation for sender failed.");
+    exit(EXIT_FAILURE);
+  }
+  sim->state[A] = s;
+  s->windowsize = sim->params.window;
+  s->seqspace = n;
+  s->A_ackeds = (uint64_t *)(s + 1);
+  s->resent = s->A_ackeds + words;
+  s->A_buffer = (struct pkt *)(s->resent + words);
+  s->deadline = (float *)(s->A_buffer + n);
+  s->sendtime = s->deadline + n;
+  s->armed = s->sendtime + n;
+  s->tnext = (int *)(s->armed + n);
+  s->tprev = s->tnext + n;
+  msgq_init(&s->queue, s->tprev + n, sim->params.sendq);
+
   /* initialize sender's window base (first unacked packet) */
-  A_base = 0;
+  s->A_base = 0;
 
   /* initialize sender's next sequence number to be used */
-  A_nextseqnum = 0;
+  s->A_nextseqnum = 0;
 
-  unacked_packets = 0;
+  s->unacked_packets = 0;
 
-  for (i = 0; i < SEQSPACE; i++) {
-    A_ackeds[i] = false; /* initialize acked state for all packets (no packets have been acked) */
-  }
+  s->thead = NOTINUSE;
+  s->ttail = NOTINUSE;
+  s->timer_running = false;
+  rto_init(sim, &s->rto, sim->params.rtt);
+  cc_init(sim, &s->cc, s->windowsize);
+  s->sack = sim_params_sack(&sim->params);
+
+  bitset_clearall(s->A_ackeds, n); /* initialize acked state for all packets (no packets have been acked) */
+  bitset_clearall(s->resent, n);
 }
 
 
 /********* Receiver (B)  variables and procedures ************/
 
-static struct pkt B_buffer[SEQSPACE];
-static bool B_received[SEQSPACE];
-static int B_expected_base = 0;
-static int B_nextseqnum = 0;
+struct sr_receiver {
+  int windowsize;
+  int seqspace;
+  struct pkt *B_buffer;           /* an entry per sequence number */
+  uint64_t *B_received;           /* bitset of the packets buffered */
+  float *B_arrival;               /* when each packet buffered arrived */
+  bool sack;                      /* ACKs carry SACK information */
+  int B_expected_base;
+  int B_nextseqnum;
+  int B_held;                     /* packets buffered and not yet delivered */
+  int ackevery;                   /* in-order packets covered by one ACK */
+  float ackdelay;                 /* longest an ACK is held back */
+  int ackpending;                 /* in-order packets received since the last ACK */
+  int acklast;                    /* the latest of them */
+};
+
+/* put B's receive base and the bitmap of the packets it holds after the
+   base in the payload of ack */
+static void sack_fill(const struct sr_receiver *r, struct pkt *ack)
+{
+  int32_t base = r->B_expected_base;
+  uint64_t map[SACK_WORDS];
+  int w, from;
+  int nbits = r->windowsize - 1;      /* B holds nothing further on */
+
+  if (nbits > SACK_BITS)
+    nbits = SACK_BITS;
+  for (w = 0; w < SACK_WORDS; w++) {
+    from = 64 * w;
+    if (from >= nbits) {
+      map[w] = 0;
+      continue;
+    }
+    map[w] = bitset_get64(r->B_received, r->seqspace, (base + 1 + from) % r->seqspace);
+    if (nbits - from < 64)
+      map[w] &= ((uint64_t)1 << (nbits - from)) - 1;
+  }
+  memcpy(ack->payload, &base, sizeof(base));
+  memcpy(ack->payload + sizeof(base), map, sizeof(map));
+}
 
-void B_input(struct pkt packet)
+/* ACK packet seq; with SACK information the ACK also covers any packets
+   whose ACK was being held back */
+static void send_ack(struct sim *sim, struct sr_receiver *r, int seq)
 {
   struct pkt sendpkt;
   int i;
+
+  if (r->ackpending > 0 && r->ackevery > 1)
+    stoptimer(sim, B);
+  r->ackpending = 0;
+
+  sendpkt.seqnum = 0; /* sender does not use seqnum*/
+  sendpkt.acknum = seq; /* ACK the sequence number of the packet */
+  if (r->sack)
+    sack_fill(r, &sendpkt);
+  else
+    for (i = 0; i < 20; i++) sendpkt.payload[i] = 0; /* payload is not used so just set to zeros */
+  sendpkt.checksum = ComputeChecksum(sendpkt);
+  tolayer3(sim, B, sendpkt);
+}
+
+static void B_input(struct sim *sim, struct pkt packet)
+{
+  struct sr_receiver *r = sim->state[B];
+  int n;
   int seq = packet.seqnum;
+  bool in_order;
 
   /* if packet is corrupted we just ignore it and do nothing else */
   if (IsCorrupted(packet)) {
     return;
   }
 
-  packets_received++; /* update global counter for received packets */
-
-  if (TRACE > 0) printf("----B: packet %d is correctly received, send ACK!\n", seq);
-
-  /* save the packet in the buffer even if it hasn't been recieved even if its out of order since SR allows that */
-  if (!B_received[seq]) {
-    B_buffer[seq] = packet;
-    B_received[seq] = true;
+  sim->stats.packets_received++; /* update counter for received packets */
+
+  if (TRACE_LEVEL(sim) > 0) trace_printf(sim, "----B: packet %d is correctly received, send ACK!\n", seq);
+
+  /* save the packet in the buffer even if it hasn't been recieved even if its out of order since SR allows that.
+  a packet behind the window was already delivered and is only ACKed again */
+  if ((seq - r->B_expected_base + r->seqspace) % r->seqspace >= r->windowsize
+      || bitset_test(r->B_received, seq))
+    sim->stats.spurious_resends++;    /* already accepted */
+  else {
+    r->B_buffer[seq] = packet;
+    r->B_arrival[seq] = sim->time;
+    bitset_set(r->B_received, seq);
+    if (seq != r->B_expected_base)
+      sim->stats.out_of_order++;      /* held until the gap fills */
+    if (++r->B_held > sim->stats.held_peak)
+      sim->stats.held_peak = r->B_held;
   }
 
   /* attempt to deliver packets to layer 5 in order */
-  /* while having the expected packet, it gets delivered and move the base forward */
-  while (B_received[B_expected_base]) {
-    tolayer5(B, B_buffer[B_expected_base].payload); /* deliver the packet to layer 5 in order */
-    B_received[B_expected_base] = false; /* reset the received flag */
-    B_expected_base = (B_expected_base + 1) % SEQSPACE; /* move the base forward */
+  /* every packet in the run of received ones from the base gets delivered and the base moves past them */
+  n = bitset_take_run(r->B_received, r->seqspace, r->B_expected_base);
+  in_order = n == 1 && seq == r->B_expected_base;
+  r->B_held -= n;
+  for (; n > 0; n--) {
+    tolayer5(sim, B, r->B_buffer[r->B_expected_base].payload); /* deliver the packet to layer 5 in order */
+    if (r->B_expected_base != seq) /* held until the gap before it filled */
+      hist_add(&sim->hol, sim->time - r->B_arrival[r->B_expected_base]);
+    r->B_expected_base = (r->B_expected_base + 1) % r->seqspace; /* move the base forward */
   }
 
-  sendpkt.seqnum = 0; /* sender does not use seqnum*/
-  sendpkt.acknum = seq; /* ACK the sequence number of the packet */
-  for (i = 0; i < 20; i++) sendpkt.payload[i] = 0; /* payload is not used so just set to zeros */
-  sendpkt.checksum = ComputeChecksum(sendpkt);
-  tolayer3(B, sendpkt);
+  /* with delayed ACKs, a packet that arrives in order and leaves no gap
+     behind it waits for ackevery others or the timer; anything else, a
+     copy, a gap or a gap filled, is ACKed at once */
+  if (in_order && ++r->ackpending < r->ackevery) {
+    r->acklast = seq;
+    if (r->ackpending == 1)
+      starttimer(sim, B, r->ackdelay);
+    return;
+  }
+  send_ack(sim, r, seq);
 }
 
-void B_init(void)
+static void B_init(struct sim *sim)
 {
-  int i;
-  B_expected_base = 0;
-  B_nextseqnum = 1;
-  for (i = 0; i < SEQSPACE; i++)
-    B_received[i] = false;
+  struct sr_receiver *r;
+  int n = sim->params.seqspace;
+
+  r = malloc(sizeof(struct sr_receiver) + BITSET_WORDS(n) * sizeof(uint64_t)
+             + n * sizeof(struct pkt) + n * sizeof(float));
+  if (r == NULL) {
+    printf("memory allocation for receiver failed.");
+    exit(EXIT_FAILURE);
+  }
+  sim->state[B] = r;
+  r->windowsize = sim->params.window;
+  r->seqspace = n;
+  r->B_received = (uint64_t *)(r + 1);
+  r->B_buffer = (struct pkt *)(r->B_received + BITSET_WORDS(n));
+  r->B_arrival = (float *)(r->B_buffer + n);
+
+  r->B_expected_base = 0;
+  r->B_nextseqnum = 1;
+  r->B_held = 0;
+  bitset_clearall(r->B_received, n);
+  r->sack = sim_params_sack(&sim->params);
+  r->ackevery = sim->params.ackevery;
+  r->ackdelay = sim->params.ackdelay;
+  r->ackpending = 0;
 }
 
 /******************************************************************************
@@ -254,11 +595,26 @@ void B_init(void)
  *****************************************************************************/
 
 /* Note that with simplex transfer from a-to-B, there is no B_output() */
-void B_output(struct msg message)
+static void B_output(struct sim *sim, struct msg message)
 {
 }
 
-/* called when B's timer goes off */
-void B_timerinterrupt(void)
+/* called when B's timer goes off: the delayed ACK is due */
+static void B_timerinterrupt(struct sim *sim)
 {
+  struct sr_receiver *r = sim->state[B];
+
+  if (TRACE_LEVEL(sim) > 0)
+    trace_printf(sim, "----B: delayed ACK timer went off, send ACK!\n");
+  r->ackpending = 0;            /* the timer is no longer running */
+  send_ack(sim, r, r->acklast);
 }
+
+const struct protocol sr_protocol = {
+  "sr", BIDIRECTIONAL, min_seqspace,
+  A_init, B_init,
+  A_output, B_output,
+  A_input, B_input,
+  A_timerinterrupt, B_timerinterrupt,
+  A_snapshot
+};
@@ -0,0 +1,319 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "sweep.h"
+
+#define MAXLINE 1024
+#define MAXAXES 32
+
+/* one parameter of the grid and the values it takes */
+struct axis {
+  char key[64];
+  char **values;
+  int nvalues;
+};
+
+struct sweep {
+  struct axis axes[MAXAXES];
+  int naxes;
+  long nruns;
+  const struct sim_params *base;
+
+  pthread_mutex_t lock;
+  long next;              /* next run to hand to a worker */
+  long nextwrite;         /* next run to write to out */
+  long failed;            /* first run that could not be created, or -1 */
+  char **rows;            /* rows[i] is the output of run i until written */
+  FILE *out;
+};
+
+static char *trim(char *s)
+{
+  char *end;
+
+  while (isspace((unsigned char)*s))
+    s++;
+  end = s + strlen(s);
+  while (end > s && isspace((unsigned char)end[-1]))
+    *--end = '\0';
+  return s;
+}
+
+static void add_value(struct axis *ax, const char *value)
+{
+  char **grown;
+
+  grown = realloc(ax->values, (ax->nvalues + 1) * sizeof(char *));
+  if (grown == NULL || (grown[ax->nvalues] = strdup(value)) == NULL) {
+    printf("memory allocation for sweep failed.");
+    exit(EXIT_FAILURE);
+  }
+  ax->values = grown;
+  ax->nvalues++;
+}
+
+/* expand start:stop:step into its values; -1 if it is not a range */
+static int add_range(struct axis *ax, const char *text)
+{
+  double start, stop, step, v;
+  char buf[64];
+  long i, n;
+
+  if (sscanf(text, "%lf:%lf:%lf", &start, &stop, &step) != 3)
+    return -1;
+  if (step <= 0.0 || stop < start)
+    return -1;
+  n = (long)((stop - start) / step + 1e-9) + 1;
+  for (i = 0; i < n; i++) {
+    v = start + i * step;
+    snprintf(buf, sizeof(buf), "%.10g", v);
+    add_value(ax, buf);
+  }
+  return 0;
+}
+
+static int parse_grid(struct sweep *sw, const char *gridfile)
+{
+  char line[MAXLINE];
+  char *p, *eq, *key, *tok, *save;
+  struct axis *ax;
+  struct sim_params scratch;
+  FILE *f;
+  int lineno = 0, i;
+
+  sw->naxes = 0;
+  f = fopen(gridfile, "r");
+  if (f == NULL) {
+    fprintf(stderr, "sweep: cannot open %s\n", gridfile);
+    return -1;
+  }
+  while (fgets(line, sizeof(line), f) != NULL) {
+    lineno++;
+    if ((p = strchr(line, '#')) != NULL)
+      *p = '\0';
+    p = trim(line);
+    if (*p == '\0')
+      continue;
+    if ((eq = strchr(p, '=')) == NULL || sw->naxes == MAXAXES)
+      goto bad;
+    *eq = '\0';
+    key = trim(p);
+    ax = &sw->axes[sw->naxes++];
+    snprintf(ax->key, sizeof(ax->key), "%s", key);
+    ax->values = NULL;
+    ax->nvalues = 0;
+    for (tok = strtok_r(eq + 1, ",", &save); tok != NULL; tok = strtok_r(NULL, ",", &save)) {
+      tok = trim(tok);
+      if (strchr(tok, ':') != NULL) {
+        if (add_range(ax, tok) < 0)
+          goto bad;
+      }
+      else
+        add_value(ax, tok);
+    }
+    if (ax->nvalues == 0)
+      goto bad;
+    /* reject unknown keys and values that do not parse now; whether the
+       values make sense is checked for each combination by check_grid() */
+    for (i = 0; i < ax->nvalues; i++) {
+      scratch = *sw->base;
+      if (sim_params_set(&scratch, ax->key, ax->values[i]) < 0)
+        goto bad;
+    }
+  }
+  fclose(f);
+  return 0;
+
+ bad:
+  fprintf(stderr, "sweep: %s:%d: bad grid line\n", gridfile, lineno);
+  fclose(f);
+  return -1;
+}
+
+static void free_grid(struct sweep *sw)
+{
+  int i, j;
+
+  for (i = 0; i < sw->naxes; i++) {
+    for (j = 0; j < sw->axes[i].nvalues; j++)
+      free(sw->axes[i].values[j]);
+    free(sw->axes[i].values);
+  }
+}
+
+/* the parameters of run number run of the grid */
+static void grid_params(const struct sweep *sw, long run, struct sim_params *params)
+{
+  int i;
+
+  *params = *sw->base;
+  for (i = sw->naxes - 1; i >= 0; i--) {
+    sim_params_set(params, sw->axes[i].key,
+                   sw->axes[i].values[run % sw->axes[i].nvalues]);
+    run /= sw->axes[i].nvalues;
+  }
+}
+
+/* check every combination before any is run, as values that are fine
+   alone may not be together (a seqspace too small for a window) */
+static int check_grid(const struct sweep *sw)
+{
+  struct sim_params params;
+  const char *err;
+  int value[MAXAXES];
+  long run, rest;
+  int i;
+
+  for (run = 0; run < sw->nruns; run++) {
+    grid_params(sw, run, &params);
+    if ((err = sim_params_check(&params)) == NULL)
+      continue;
+    for (rest = run, i = sw->naxes - 1; i >= 0; i--) {
+      value[i] = rest % sw->axes[i].nvalues;
+      rest /= sw->axes[i].nvalues;
+    }
+    fprintf(stderr, "sweep: run %ld (", run);
+    for (i = 0; i < sw->naxes; i++)
+      fprintf(stderr, "%s%s = %s", i > 0 ? ", " : "", sw->axes[i].key,
+              sw->axes[i].values[value[i]]);
+    fprintf(stderr, "): %s\n", err);
+    return -1;
+  }
+  return 0;
+}
+
+/* run number run of the grid and return its output row, NULL if the run
+   could not be created */
+static char *run_one(struct sweep *sw, long run)
+{
+  struct sim_params params;
+  struct sim *sim;
+  char *row = NULL;
+  size_t len = 0;
+  FILE *out;
+
+  grid_params(sw, run, &params);
+  params.trace = 0;        /* workers share stdout */
+  params.tracefile[0] = '\0';
+  params.recordfile[0] = '\0';
+  params.rtolog[0] = '\0';
+  params.cwndlog[0] = '\0';
+  params.samplelog[0] = '\0';
+
+  sim = sim_create(&params);
+  if (sim == NULL)
+    return NULL;
+  sim_run(sim);
+  out = open_memstream(&row, &len);
+  if (out == NULL) {
+    printf("memory allocation for sweep failed.");
+    exit(EXIT_FAILURE);
+  }
+  fprintf(out, "%ld,", run);
+  sim_write_row(sim, out);
+  fclose(out);
+  sim_free(sim);
+  return row;
+}
+
+static void *worker(void *arg)
+{
+  struct sweep *sw = arg;
+  char *row;
+  long run;
+
+  for (;;) {
+    pthread_mutex_lock(&sw->lock);
+    run = sw->next++;
+    pthread_mutex_unlock(&sw->lock);
+    if (run >= sw->nruns)
+      return NULL;
+    row = run_one(sw, run);
+    if (row == NULL) {
+      /* hand out no more runs; the rows before this one still go out */
+      pthread_mutex_lock(&sw->lock);
+      if (sw->failed < 0 || run < sw->failed)
+        sw->failed = run;
+      sw->next = sw->nruns;
+      pthread_mutex_unlock(&sw->lock);
+      return NULL;
+    }
+
+    /* write rows in run order so the file does not depend on the thread
+       count, and as soon as possible so they need not all be held */
+    pthread_mutex_lock(&sw->lock);
+    sw->rows[run] = row;
+    while (sw->nextwrite < sw->nruns && sw->rows[sw->nextwrite] != NULL
+           && (sw->failed < 0 || sw->nextwrite < sw->failed)) {
+      fputs(sw->rows[sw->nextwrite], sw->out);
+      free(sw->rows[sw->nextwrite]);
+      sw->rows[sw->nextwrite++] = NULL;
+    }
+    pthread_mutex_unlock(&sw->lock);
+  }
+}
+
+int sweep_run(const char *gridfile, const struct sim_params *base,
+              FILE *out, int nthreads)
+{
+  struct sweep sw;
+  pthread_t *threads;
+  long run;
+  int t;
+
+  sw.base = base;
+  if (parse_grid(&sw, gridfile) < 0) {
+    free_grid(&sw);
+    return -1;
+  }
+  sw.nruns = 1;
+  for (t = 0; t < sw.naxes; t++)
+    sw.nruns *= sw.axes[t].nvalues;
+  if (check_grid(&sw) < 0) {
+    free_grid(&sw);
+    return -1;
+  }
+  sw.next = 0;
+  sw.nextwrite = 0;
+  sw.failed = -1;
+  sw.out = out;
+  pthread_mutex_init(&sw.lock, NULL);
+
+  if (nthreads <= 0)
+    nthreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  if (nthreads <= 0)
+    nthreads = 1;
+  if (nthreads > sw.nruns)
+    nthreads = (int)sw.nruns;
+
+  sw.rows = calloc(sw.nruns, sizeof(char *));
+  threads = malloc(nthreads * sizeof(pthread_t));
+  if (sw.rows == NULL || threads == NULL) {
+    printf("memory allocation for sweep failed.");
+    exit(EXIT_FAILURE);
+  }
+  fprintf(out, "run,");
+  sim_write_header(out);
+  for (t = 0; t < nthreads; t++)
+    if (pthread_create(&threads[t], NULL, worker, &sw) != 0) {
+      printf("sweep: cannot create worker thread.");
+      exit(EXIT_FAILURE);
+    }
+  for (t = 0; t < nthreads; t++)
+    pthread_join(threads[t], NULL);
+  if (sw.failed >= 0) {
+    fprintf(stderr, "sweep: run %ld could not be created, the runs from it on are not written\n",
+            sw.failed);
+    for (run = sw.failed; run < sw.nruns; run++)
+      free(sw.rows[run]);
+  }
+
+  free(threads);
+  free(sw.rows);
+  pthread_mutex_destroy(&sw.lock);
+  free_grid(&sw);
+  return sw.failed >= 0 ? -1 : 0;
+}
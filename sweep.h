@@ -0,0 +1,30 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+
+/* Parameter sweeps.
+
+   A grid file lists the values to try for any of the parameters known to
+   sim_params_set(), one parameter per line:
+
+     # comment
+     loss    = 0.0, 0.1, 0.2
+     lambda  = 5:50:5          (start:stop:step, stop included)
+     seed    = 1:10:1
+
+   Every combination is run, the last parameter in the file varying
+   fastest; parameters not in the grid keep the value from base.  Runs
+   are spread over a pool of threads but every run has its own simulator
+   context and generator, so the rows written to out are the same, and
+   in the same order, whatever the number of threads. */
+
+#include <stdio.h>
+#include "sim.h"
+
+/* run the grid in gridfile; nthreads <= 0 uses one thread per online
+   CPU.  Returns 0 on success, -1 if the grid could not be read or one of
+   its combinations is not a valid run, before any is run, or if a run
+   could not be created, after writing the rows before it. */
+extern int sweep_run(const char *gridfile, const struct sim_params *base,
+                     FILE *out, int nthreads);
+
+#endif
@@ -0,0 +1,89 @@
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include "trace.h"
+#include "sim.h"
+
+void trace_open(struct trace_sink *t, const char *path)
+{
+  t->len = 0;
+  t->out = stdout;
+  t->closeout = 0;
+  if (path != NULL && path[0] != '\0') {
+    t->out = fopen(path, "w");
+    if (t->out == NULL) {
+      fprintf(stderr, "cannot open trace file %s, tracing to stdout\n", path);
+      t->out = stdout;
+    }
+    else
+      t->closeout = 1;
+  }
+  t->buf = malloc(TRACE_BUFSIZE);
+  if (t->buf == NULL) {
+    printf("memory allocation for trace buffer failed.");
+    exit(EXIT_FAILURE);
+  }
+}
+
+void trace_flush(struct trace_sink *t)
+{
+  if (t->len > 0) {
+    fwrite(t->buf, 1, t->len, t->out);
+    t->len = 0;
+  }
+  fflush(t->out);
+}
+
+void trace_close(struct trace_sink *t)
+{
+  trace_flush(t);
+  if (t->closeout)
+    fclose(t->out);
+  free(t->buf);
+  t->buf = NULL;
+}
+
+void trace_printf(struct sim *sim, const char *fmt, ...)
+{
+  struct trace_sink *t = &sim->tsink;
+  va_list ap;
+  int n;
+
+  va_start(ap, fmt);
+  n = vsnprintf(t->buf + t->len, TRACE_BUFSIZE - t->len, fmt, ap);
+  va_end(ap);
+  if (n < 0)
+    return;
+  if ((size_t)n < TRACE_BUFSIZE - t->len) {
+    t->len += n;
+    return;
+  }
+
+  /* did not fit: make room and format again */
+  fwrite(t->buf, 1, t->len, t->out);
+  t->len = 0;
+  va_start(ap, fmt);
+  if (n < TRACE_BUFSIZE) {
+    vsnprintf(t->buf, TRACE_BUFSIZE, fmt, ap);
+    t->len = n;
+  }
+  else
+    vfprintf(t->out, fmt, ap);
+  va_end(ap);
+}
+
+void trace_write(struct sim *sim, const char *data, size_t n)
+{
+  struct trace_sink *t = &sim->tsink;
+
+  if (t->len + n > TRACE_BUFSIZE) {
+    fwrite(t->buf, 1, t->len, t->out);
+    t->len = 0;
+  }
+  if (n > TRACE_BUFSIZE)
+    fwrite(data, 1, n, t->out);
+  else {
+    memcpy(t->buf + t->len, data, n);
+    t->len += n;
+  }
+}
@@ -0,0 +1,52 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+/* Trace output of a simulation.
+
+   Trace messages are guarded by the simulation's TRACE level:
+
+     if (TRACE_LEVEL(sim) > 2)
+       trace_printf(sim, "...");
+
+   Building with -DNTRACE makes TRACE_LEVEL() the constant 0, so every
+   guarded message is removed by the compiler and a benchmark build pays
+   nothing for tracing.
+
+   Messages are formatted into a large per-simulation buffer that is
+   written out in big blocks, instead of going through stdio one call at
+   a time.  The buffer is flushed when it fills, when the simulation ends
+   and before its report is printed, so trace and report never
+   interleave. */
+
+#include <stdio.h>
+#include <stddef.h>
+
+#ifdef NTRACE
+#define TRACE_LEVEL(sim) 0
+#else
+#define TRACE_LEVEL(sim) ((sim)->trace)
+#endif
+
+#define TRACE_BUFSIZE (1 << 20)   /* bytes buffered before a write */
+
+struct trace_sink {
+  char *buf;
+  size_t len;             /* bytes waiting in buf */
+  FILE *out;
+  int closeout;           /* out was opened by trace_open() */
+};
+
+struct sim;
+
+/* send the trace to the file called path, or stdout if path is empty */
+extern void trace_open(struct trace_sink *t, const char *path);
+extern void trace_flush(struct trace_sink *t);
+extern void trace_close(struct trace_sink *t);
+
+extern void trace_printf(struct sim *sim, const char *fmt, ...)
+  __attribute__((format(printf, 2, 3)));
+
+/* append n raw bytes (packet payloads are not NUL terminated) */
+extern void trace_write(struct sim *sim, const char *data, size_t n);
+
+#endif
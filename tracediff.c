@@ -0,0 +1,103 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "record.h"
+
+/* Compare two binary event records (see record.h) and report the first
+   record where they differ, or print one record file as text.
+
+   usage: tracediff [-c N] OLD NEW
+          tracediff -p FILE */
+
+#define CONTEXT 5   /* default number of matching records shown before a divergence */
+
+static int dump(const char *path)
+{
+  struct record rec;
+  FILE *f;
+  long n = 0;
+
+  if ((f = record_open(path)) == NULL)
+    return 2;
+  while (record_get(f, &rec))
+    record_print(stdout, n++, &rec);
+  fclose(f);
+  return 0;
+}
+
+static int diff(const char *oldpath, const char *newpath, int context)
+{
+  struct record a, b;
+  struct record *ring;
+  FILE *fa, *fb;
+  long n = 0, i;
+  int gota, gotb;
+
+  fa = record_open(oldpath);
+  fb = record_open(newpath);
+  if (fa == NULL || fb == NULL) {
+    if (fa != NULL)
+      fclose(fa);
+    if (fb != NULL)
+      fclose(fb);
+    return 2;
+  }
+  ring = malloc((context + 1) * sizeof(struct record));
+  if (ring == NULL) {
+    printf("memory allocation failed.");
+    exit(EXIT_FAILURE);
+  }
+
+  for (;;) {
+    gota = record_get(fa, &a);
+    gotb = record_get(fb, &b);
+    if (!gota || !gotb || !record_same(&a, &b))
+      break;
+    ring[n % (context + 1)] = a;
+    n++;
+  }
+  fclose(fa);
+  fclose(fb);
+
+  if (!gota && !gotb) {
+    printf("records are identical (%ld records)\n", n);
+    free(ring);
+    return 0;
+  }
+  printf("first divergence at record %ld\n", n);
+  for (i = n > context ? n - context : 0; i < n; i++)
+    record_print(stdout, i, &ring[i % (context + 1)]);
+  printf("--- %s\n", oldpath);
+  if (gota)
+    record_print(stdout, n, &a);
+  else
+    printf("%8ld  (end of file)\n", n);
+  printf("+++ %s\n", newpath);
+  if (gotb)
+    record_print(stdout, n, &b);
+  else
+    printf("%8ld  (end of file)\n", n);
+  free(ring);
+  return 1;
+}
+
+int main(int argc, char **argv)
+{
+  int context = CONTEXT;
+  int argi = 1;
+
+  if (argc == 3 && strcmp(argv[1], "-p") == 0)
+    return dump(argv[2]);
+  if (argc == 5 && strcmp(argv[1], "-c") == 0) {
+    context = atoi(argv[2]);
+    if (context < 0)
+      context = 0;
+    argi = 3;
+  }
+  if (argc - argi != 2) {
+    fprintf(stderr, "usage: %s [-c N] OLD NEW   report the first divergence\n", argv[0]);
+    fprintf(stderr, "       %s -p FILE          print a record file\n", argv[0]);
+    return 2;
+  }
+  return diff(argv[argi], argv[argi + 1], context);
+}